@@ -6,7 +6,11 @@
 #include "chip8stack.h"
 #include "chip8screen.h"
 #include "chip8keyboard.h"
+#include "chip8quirks.h"
+#include "chip8rom.h"
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct chip8
 {
@@ -15,13 +19,92 @@ struct chip8
     struct chip8_registers registers;
     struct chip8_keyboard keyboard;
     struct chip8_screen screen;
+
+    /* SUPER-CHIP user flags, saved and restored by Fx75 and Fx85. */
+    unsigned char rpl[CHIP8_TOTAL_RPL_FLAGS];
+
+    /* XO-CHIP sound, loaded by F002 and Fx3A. */
+    unsigned char audio_pattern[CHIP8_AUDIO_PATTERN_SIZE];
+    unsigned char pitch;
+
+    /* Set by chip8_load from the ROM database, see chip8romdb.h. quirks
+    holds CHIP8_QUIRK_* bits. */
+    uint64_t rom_hash;
+    unsigned char quirks;
+    unsigned short instructions_per_frame;
+
+    /* State of the generator behind Cxkk (RND). */
+    uint32_t random;
+
+    /* Set by 00FD (EXIT). PC stays on the EXIT instruction. */
+    bool exited;
+
+    /* Number of instructions executed since chip8_init. */
+    unsigned long long instruction_count;
+
+    /* Number of 60Hz frames ended since chip8_init, which the timers count 
+    down by. */
+    unsigned long long frames;
+};
+
+/* Why chip8_run or one of the instrumented cores returned. */
+enum chip8_stop_reason
+{
+    CHIP8_STOP_BUDGET,      /* The requested number of instructions ran. */
+    CHIP8_STOP_BREAKPOINT,  /* PC reached a breakpoint, not yet executed. */
+    CHIP8_STOP_WATCHPOINT,  /* The next instruction writes watched memory. */
+    CHIP8_STOP_EXIT         /* The program executed 00FD (EXIT). */
 };
 
 void chip8_init(struct chip8 *chip8);
 
-/* Loads the buffer into the chip8 memory. */
-void chip8_load(struct chip8 *chip8, const char *buf, size_t size);
+/* Seeds the random numbers of Cxkk. chip8_init uses a seed of 0, so runs 
+are reproducible unless the frontend seeds from the clock. */
+void chip8_seed(struct chip8 *chip8, uint32_t seed);
+
+/* Loads the buffer into the chip8 memory. Known ROMs also get their quirk 
+profile, speed and key map from the ROM database. Returns CHIP8_ROM_OK, or 
+CHIP8_ROM_ERROR_EMPTY or CHIP8_ROM_ERROR_TOO_LARGE leaving the chip8 as it 
+was. */
+int chip8_load(struct chip8 *chip8, const char *buf, size_t size);
 
+/* Executes one opcode with the quirks of chip8->quirks. */
 void chip8_exec(struct chip8 *chip8, unsigned short opcode);
 
+/* Fetches the instruction at PC, advances PC and executes it. */
+void chip8_step(struct chip8 *chip8);
+
+/* Executes up to "budget" instructions. A program idling in a jump to 
+itself, or waiting in a loop for the delay timer that it can't leave before 
+the frame ends, has the loop's remaining iterations counted without running 
+them. */
+enum chip8_stop_reason chip8_run(struct chip8 *chip8, int budget);
+
+/* Ends a 60Hz frame, the delay and sound timers count down once. */
+void chip8_end_frame(struct chip8 *chip8);
+
+/* Runs one 60Hz frame: instructions_per_frame instructions, then 
+chip8_end_frame. */
+enum chip8_stop_reason chip8_run_frame(struct chip8 *chip8);
+
+static inline unsigned char chip8_delay_timer(const struct chip8 *chip8)
+{
+    return chip8_timer_get(&chip8->registers.delay_timer, chip8->frames);
+}
+
+static inline unsigned char chip8_sound_timer(const struct chip8 *chip8)
+{
+    return chip8_timer_get(&chip8->registers.sound_timer, chip8->frames);
+}
+
+#ifdef CHIP8_INCREMENTAL_HASH
+/* Hashes everything that decides what the program does next, leaving out 
+the keys and the instruction count, in constant time. Memory and the screen 
+keep Zobrist hashes updated on every write, see chip8_zobrist in chip8hash.h. 
+Code writing memory or the screen directly must call chip8_memory_rehash or 
+chip8_screen_rehash. Only built with CHIP8_INCREMENTAL_HASH defined, so the 
+interpreter pays nothing for it otherwise. */
+uint64_t chip8_state_hash(const struct chip8 *chip8);
+#endif
+
 #endif
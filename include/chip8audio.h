@@ -0,0 +1,12 @@
+#ifndef CHIP8AUDIO_H
+#define CHIP8AUDIO_H
+
+#include "chip8.h"
+
+/* Renders "count" unsigned 8-bit mono samples of the audio pattern at the 
+current pitch. "phase" is the position in the pattern, in bits, and carries 
+over between calls so consecutive buffers join up. */
+void chip8_audio_render(struct chip8 *chip8, unsigned char *samples, 
+                        int count, int sample_rate, double *phase);
+
+#endif
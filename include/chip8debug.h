@@ -0,0 +1,67 @@
+#ifndef CHIP8DEBUG_H
+#define CHIP8DEBUG_H
+
+#include <stdbool.h>
+#include "config.h"
+#include "chip8.h"
+
+/* How a breakpoint compares its register against its value. */
+enum chip8_condition
+{
+    CHIP8_CONDITION_ALWAYS,
+    CHIP8_CONDITION_EQUAL,
+    CHIP8_CONDITION_NOT_EQUAL,
+    CHIP8_CONDITION_LESS,
+    CHIP8_CONDITION_GREATER
+};
+
+struct chip8_breakpoint
+{
+    unsigned short address;
+    enum chip8_condition condition;
+    unsigned char reg;
+    unsigned char value;
+};
+
+/* Stops before any instruction writes to [start, end]. */
+struct chip8_watchpoint
+{
+    unsigned short start;
+    unsigned short end;
+};
+
+struct chip8_debugger
+{
+    /* One bit per address. A set bit means a breakpoint lives there and the
+    list below has to be consulted, which keeps the common miss to one load. */
+    unsigned char breakpoint_map[CHIP8_MEMORY_SIZE / 8];
+    struct chip8_breakpoint breakpoints[CHIP8_TOTAL_BREAKPOINTS];
+    int breakpoint_count;
+
+    /* One bit per CHIP8_WATCH_PAGE_SIZE bytes of memory. */
+    unsigned char watch_map[CHIP8_MEMORY_SIZE / CHIP8_WATCH_PAGE_SIZE / 8 + 1];
+    struct chip8_watchpoint watchpoints[CHIP8_TOTAL_WATCHPOINTS];
+    int watchpoint_count;
+
+    /* Set after a stop so the next run can step over the instruction that
+    caused it. */
+    bool resuming;
+};
+
+void chip8_debug_init(struct chip8_debugger *debugger);
+
+/* Returns 0 on success, -1 when the table is full or the range is invalid. 
+Every unsigned short is an address, CHIP8_MEMORY_SIZE being 64KB, so 
+callers parsing wider numbers check them before narrowing. */
+int chip8_debug_add_breakpoint(struct chip8_debugger *debugger,
+                               const struct chip8_breakpoint *breakpoint);
+int chip8_debug_add_watchpoint(struct chip8_debugger *debugger,
+                               unsigned short start, unsigned short end);
+void chip8_debug_clear(struct chip8_debugger *debugger);
+
+/* Like chip8_run, but stops on breakpoints and watchpoints. Without any set
+this is chip8_run itself. */
+enum chip8_stop_reason chip8_debug_run(struct chip8_debugger *debugger,
+                                       struct chip8 *chip8, int budget);
+
+#endif
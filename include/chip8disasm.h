@@ -0,0 +1,24 @@
+#ifndef CHIP8DISASM_H
+#define CHIP8DISASM_H
+
+#include <stddef.h>
+
+/* Longest mnemonic, without the terminating zero. */
+#define CHIP8_DISASM_MAX_MNEMONIC 24
+
+/* Longest listing line: "0200: F000 1234  LD I, #1234\n". */
+#define CHIP8_DISASM_MAX_LINE (17 + CHIP8_DISASM_MAX_MNEMONIC)
+
+/* Writes the mnemonic for "opcode" and a terminating zero to "out", which
+must hold CHIP8_DISASM_MAX_MNEMONIC + 1 bytes. "next" is the word following 
+the opcode, only used by 4-byte instructions. Returns the length. */
+int chip8_disasm_instruction(unsigned short opcode, unsigned short next, 
+                             char *out);
+
+/* Writes a listing of "size" bytes of "code" loaded at "address", one line
+per instruction. "out" must hold (size + 1) / 2 * CHIP8_DISASM_MAX_LINE + 1
+bytes. Returns the length of the listing. */
+size_t chip8_disasm(const unsigned char *code, size_t size,
+                    unsigned short address, char *out);
+
+#endif
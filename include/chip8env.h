@@ -0,0 +1,96 @@
+#ifndef CHIP8ENV_H
+#define CHIP8ENV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "chip8.h"
+
+/*
+A batch of emulators for training agents, stepped together in the style of a
+Gym vector environment.
+
+Every instance runs the same ROM. An action is the keyboard held during the
+step, one bit per Chip-8 key, and a step runs "frameskip" frames with it.
+Observations are the screen at 64x32, written into one contiguous buffer
+holding the observation of every instance in order:
+
+    CHIP8_ENV_OBSERVE_BITS   CHIP8_ENV_BITS_SIZE bytes, 8 pixels per byte,
+                             the leftmost pixel in the most significant bit.
+    CHIP8_ENV_OBSERVE_BYTES  CHIP8_ENV_BYTES_SIZE bytes, one per pixel,
+                             holding its colour (0 to 3, see chip8screen.h).
+
+High resolution screens are halved, a pixel being set when any of the four it
+covers is.
+
+Instances are reset by copying the state loaded at creation, so stepping
+and resetting never allocate. Separate environments share nothing and may be
+stepped on separate threads.
+*/
+
+#define CHIP8_ENV_BITS_SIZE (CHIP8_WIDTH * CHIP8_HEIGHT / 8)
+#define CHIP8_ENV_BYTES_SIZE (CHIP8_WIDTH * CHIP8_HEIGHT)
+
+enum chip8_env_observation
+{
+    CHIP8_ENV_OBSERVE_BITS,
+    CHIP8_ENV_OBSERVE_BYTES
+};
+
+/* Called after every frame of instance "id". Returns the reward for the
+frame and may set "done" to end the episode. */
+typedef float (*chip8_env_reward_fn)(const struct chip8 *chip8, int id,
+                                     bool *done, void *data);
+
+struct chip8_env
+{
+    int count;
+    struct chip8 *instances;
+
+    /* Frames run since each instance was reset. */
+    unsigned int *frames;
+
+    /* The state every instance is reset to, after chip8_load. */
+    struct chip8 initial;
+
+    /* Settings, may be changed between steps. An episode also ends when the
+    program exits, or after max_frames frames unless it is 0. */
+    int frameskip;
+    enum chip8_env_observation observation;
+    unsigned int max_frames;
+    chip8_env_reward_fn reward;
+    void *reward_data;
+
+    /* Each reset seeds the instance with seed plus the number of resets
+    so far, so episodes differ but runs are reproducible. */
+    uint32_t seed;
+    uint32_t resets;
+};
+
+/* Loads the ROM into "count" instances, with a frameskip of 4, bit
+observations, no episode limit and no reward. Returns CHIP8_ROM_OK, a ROM
+error of chip8_load, or CHIP8_ROM_ERROR_OPEN when out of memory. The
+instances still need chip8_env_reset. */
+int chip8_env_create(struct chip8_env *env, const char *buf, size_t size,
+                     int count);
+
+/* Returns the size in bytes of one observation. */
+size_t chip8_env_observation_size(const struct chip8_env *env);
+
+/* Resets the "num" instances listed in "ids", or every instance when "ids"
+is NULL, and writes their observations into "obs". "obs" holds the
+observations of all instances, those not reset are left untouched. */
+void chip8_env_reset(struct chip8_env *env, const int *ids, int num,
+                     void *obs);
+
+/* Steps every instance with actions[id] held down. Writes each instance's
+observation, its reward summed over the frames and whether the episode
+ended. An instance whose episode ended is reset straight away, its
+observation being the first of the next episode. */
+void chip8_env_step(struct chip8_env *env, const uint16_t *actions,
+                    void *obs, float *reward, bool *done);
+
+void chip8_env_destroy(struct chip8_env *env);
+
+#endif
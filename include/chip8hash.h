@@ -0,0 +1,29 @@
+#ifndef CHIP8HASH_H
+#define CHIP8HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* xxHash64 of "size" bytes, identifying ROMs by their contents. */
+uint64_t chip8_hash(const void *data, size_t size, uint64_t seed);
+
+/* splitmix64's finaliser, a bijection scattering every input bit. */
+static inline uint64_t chip8_hash_mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* The Zobrist key of "value" at "position", 0 for a value of 0. XORing the
+keys of every part of a state hashes it, and a write updates the hash by
+XORing out the old value's key and in the new one's. Keys are derived rather
+than looked up, as 64-bit screen words can't index a table. */
+static inline uint64_t chip8_zobrist(uint64_t position, uint64_t value)
+{
+    if (value == 0)
+        return 0;
+    return chip8_hash_mix(value ^ chip8_hash_mix(position + 1));
+}
+
+#endif
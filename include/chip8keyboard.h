@@ -12,6 +12,7 @@ A	0	B	F
 */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "config.h"
 
 struct chip8_keyboard
@@ -26,4 +27,9 @@ void chip8_keyboard_down(struct chip8_keyboard *keyboard, int key);
 void chip8_keyboard_up(struct chip8_keyboard *keyboard, int key);
 _Bool chip8_keyboard_is_down(struct chip8_keyboard *keyboard, int key);
 
+/* All keys as a mask, bit n set when key n is down, as input scripts, 
+netplay and the tools pass them around. */
+void chip8_keyboard_set_mask(struct chip8_keyboard *keyboard, uint16_t keys);
+uint16_t chip8_keyboard_get_mask(const struct chip8_keyboard *keyboard);
+
 #endif
@@ -1,21 +1,81 @@
 #ifndef CHIP8MEMORY_H
 #define CHIP8MEMORY_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "config.h"
 
+#define CHIP8_CODE_MAP_SIZE (CHIP8_MEMORY_SIZE / CHIP8_CODE_BLOCK_SIZE / 8)
+
 struct chip8_memory
 {
     unsigned char memory[CHIP8_MEMORY_SIZE];
+
+    /* One bit per CHIP8_CODE_BLOCK_SIZE bytes, set once an instruction in 
+    the block is fetched, and once a byte of it is written by the program. 
+    Loading the ROM doesn't count as a write. */
+    unsigned char executed_map[CHIP8_CODE_MAP_SIZE];
+    unsigned char written_map[CHIP8_CODE_MAP_SIZE];
+
+    /* Writes to blocks already executed, and the address of the first. */
+    unsigned long code_writes;
+    int first_code_write;
+
+    /* Called after each write to an executed block, unless NULL. Set it 
+    after chip8_init, which clears it. Caches of decoded code drop what they 
+    hold for the block there. */
+    void (*code_written)(void *context, int index);
+    void *code_written_context;
+
+#ifdef CHIP8_INCREMENTAL_HASH
+    /* The XOR of chip8_zobrist(address, byte) over all of memory, kept up to
+    date by chip8_memory_set. */
+    uint64_t hash;
+#endif
 };
 
 /* Implement function that talk to memory. */
 
-/* Set the index in the "memory" array. */
+/* Set the index in the "memory" array. Indices past the end wrap around. */
 void chip8_memory_set(struct chip8_memory *memory, int index, unsigned char val);
 
-/* Get the value at the index in the "memory" array. */
+/* Get the value at the index in the "memory" array, wrapping like set. */
 unsigned char chip8_memory_get(struct chip8_memory *memory, int index);
 
 unsigned short chip8_memory_get_short(struct chip8_memory *memory, int index);
 
+/* Marks the blocks holding the opcode at "index" as executed, both bytes 
+as XO-CHIP code can be at odd addresses. Every fetch calls it, so it only 
+sets bits. */
+static inline void chip8_memory_mark_executed(struct chip8_memory *memory, 
+                                              int index)
+{
+    int first = index / CHIP8_CODE_BLOCK_SIZE;
+    int last = ((index + 1) & (CHIP8_MEMORY_SIZE - 1)) / CHIP8_CODE_BLOCK_SIZE;
+    memory->executed_map[first / 8] |= 1 << (first % 8);
+    memory->executed_map[last / 8] |= 1 << (last % 8);
+}
+
+/* Whether an instruction in the block holding "index" was ever fetched. */
+static inline bool chip8_memory_executed(const struct chip8_memory *memory, 
+                                         int index)
+{
+    int block = index / CHIP8_CODE_BLOCK_SIZE;
+    return memory->executed_map[block / 8] & (1 << (block % 8));
+}
+
+/* Whether the program ever wrote to the block holding "index". */
+static inline bool chip8_memory_written(const struct chip8_memory *memory, 
+                                        int index)
+{
+    int block = index / CHIP8_CODE_BLOCK_SIZE;
+    return memory->written_map[block / 8] & (1 << (block % 8));
+}
+
+#ifdef CHIP8_INCREMENTAL_HASH
+/* Computes the hash again, after memory was written without 
+chip8_memory_set. */
+void chip8_memory_rehash(struct chip8_memory *memory);
+#endif
+
 #endif
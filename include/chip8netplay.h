@@ -0,0 +1,101 @@
+#ifndef CHIP8NETPLAY_H
+#define CHIP8NETPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "chip8.h"
+
+/*
+Two player netplay with rollback. Each side sends its keyboard, one bit per
+Chip-8 key, for every frame over UDP and both run the program with the OR of
+the two keyboards.
+
+Frames run as soon as the local input is known. Input the peer hasn't sent
+yet is predicted to be the same as its last known input. When it arrives
+and differs, the chip8 is restored from the snapshot taken before that frame
+and the frames since are run again, so both sides end up with the same
+state without waiting on the network. A side never runs more than
+CHIP8_NETPLAY_MAX_ROLLBACK frames ahead of the input it has from its peer.
+
+Packets repeat every input the peer hasn't acknowledged, so lost packets
+need no retransmission. All numbers are little-endian:
+
+    "C8NP"  uint32 first frame  uint32 ack  uint8 count  uint16 keys[count]
+
+"ack" tells the peer the sender has all of its inputs before that frame.
+*/
+
+struct chip8_netplay_stats
+{
+    /* The last chip8_netplay_advance. */
+    int rollback_depth;     /* Frames run again, 0 when nothing was wrong. */
+    double resim_ms;        /* Time spent running them. */
+
+    /* Since chip8_netplay_open. */
+    unsigned long long frames;
+    unsigned long long rollbacks;
+    unsigned long long resimulated_frames;
+    unsigned long long stalls;    /* Waiting for the peer, too far ahead. */
+    int max_rollback_depth;
+    double total_resim_ms;
+};
+
+struct chip8_netplay
+{
+    struct chip8 *chip8;
+
+    /* A SOCKET on Windows. */
+    intptr_t socket;
+    unsigned char peer[128];
+    int peer_size;
+
+    /* The next frame to run. */
+    unsigned long long frame;
+
+    /* Inputs by frame % CHIP8_NETPLAY_INPUT_HISTORY. remote_inputs holds
+    every frame before remote_confirmed, and frames the peer sent ahead of
+    that when remote_known is set. predicted is the remote input each frame
+    ran with. */
+    uint16_t local_inputs[CHIP8_NETPLAY_INPUT_HISTORY];
+    uint16_t remote_inputs[CHIP8_NETPLAY_INPUT_HISTORY];
+    bool remote_known[CHIP8_NETPLAY_INPUT_HISTORY];
+    uint16_t predicted[CHIP8_NETPLAY_INPUT_HISTORY];
+    unsigned long long remote_confirmed;
+
+    /* The peer has every local input before this frame. */
+    unsigned long long peer_ack;
+
+    /* The earliest frame run with a wrong prediction, or ULLONG_MAX. */
+    unsigned long long rollback_from;
+
+    /* The chip8 before frame f, at f % CHIP8_NETPLAY_MAX_ROLLBACK. */
+    struct chip8 snapshots[CHIP8_NETPLAY_MAX_ROLLBACK];
+
+    struct chip8_netplay_stats stats;
+};
+
+/* Splits "LOCALPORT:HOST:PORT", the host may itself hold colons. Returns 0
+on success and -1 on error. */
+int chip8_netplay_parse(const char *arg, int *local_port, char *host, 
+                        size_t host_size, int *peer_port);
+
+/* Binds UDP "local_port" and plays against "peer_host":"peer_port". Returns
+0 on success and -1 on error. */
+int chip8_netplay_open(struct chip8_netplay *netplay, struct chip8 *chip8,
+                       int local_port, const char *peer_host, int peer_port);
+
+/* Handles the packets received, rolls back if a prediction was wrong and
+runs the next frame with the local keys. Returns 1 when a frame ran and 0
+when waiting for the peer, in which case it should be called again with the
+same keys. */
+int chip8_netplay_advance(struct chip8_netplay *netplay, uint16_t keys);
+
+/* Handles packets and rollbacks without running a frame. Returns true once
+every frame so far ran with the peer's real input. */
+bool chip8_netplay_sync(struct chip8_netplay *netplay);
+
+void chip8_netplay_close(struct chip8_netplay *netplay);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef CHIP8OPCODES_H
+#define CHIP8OPCODES_H
+
+/*
+Every instruction the interpreter understands, in decoding order. An opcode
+matches an entry when (opcode & mask) == pattern, the first match wins so more
+specific entries come first. The format is the mnemonic used by the
+disassembler, where these placeholders are replaced:
+
+%nnn - A 12-bit value, the lowest 12 bits of the instruction
+%n   - A 4-bit value, the lowest 4 bits of the instruction
+%x   - A 4-bit value, the lower 4 bits of the high byte of the instruction
+%y   - A 4-bit value, the upper 4 bits of the low byte of the instruction
+%kk  - An 8-bit value, the lowest 8 bits of the instruction
+%nnnn - The 16-bit word following the instruction, only F000 is 4 bytes long
+%oooo - The whole opcode
+
+X(name, mask, pattern, format)
+*/
+#define CHIP8_OPCODE_TABLE(X) \
+    X(CLS,      0xffff, 0x00e0, "CLS")                 \
+    X(RET,      0xffff, 0x00ee, "RET")                 \
+    X(SCD,      0xfff0, 0x00c0, "SCD %n")              \
+    X(SCU,      0xfff0, 0x00d0, "SCU %n")              \
+    X(SCR,      0xffff, 0x00fb, "SCR")                 \
+    X(SCL,      0xffff, 0x00fc, "SCL")                 \
+    X(EXIT,     0xffff, 0x00fd, "EXIT")                \
+    X(LOW,      0xffff, 0x00fe, "LOW")                 \
+    X(HIGH,     0xffff, 0x00ff, "HIGH")                \
+    X(SYS,      0xf000, 0x0000, "SYS %nnn")            \
+    X(JP,       0xf000, 0x1000, "JP %nnn")             \
+    X(CALL,     0xf000, 0x2000, "CALL %nnn")           \
+    X(SE_BYTE,  0xf000, 0x3000, "SE V%x, %kk")         \
+    X(SNE_BYTE, 0xf000, 0x4000, "SNE V%x, %kk")        \
+    X(SE_REG,   0xf00f, 0x5000, "SE V%x, V%y")         \
+    X(SAVE,     0xf00f, 0x5002, "SAVE V%x - V%y")      \
+    X(LOAD,     0xf00f, 0x5003, "LOAD V%x - V%y")      \
+    X(LD_BYTE,  0xf000, 0x6000, "LD V%x, %kk")         \
+    X(ADD_BYTE, 0xf000, 0x7000, "ADD V%x, %kk")        \
+    X(LD_REG,   0xf00f, 0x8000, "LD V%x, V%y")         \
+    X(OR,       0xf00f, 0x8001, "OR V%x, V%y")         \
+    X(AND,      0xf00f, 0x8002, "AND V%x, V%y")        \
+    X(XOR,      0xf00f, 0x8003, "XOR V%x, V%y")        \
+    X(ADD_REG,  0xf00f, 0x8004, "ADD V%x, V%y")        \
+    X(SUB,      0xf00f, 0x8005, "SUB V%x, V%y")        \
+    X(SHR,      0xf00f, 0x8006, "SHR V%x {, V%y}")     \
+    X(SUBN,     0xf00f, 0x8007, "SUBN V%x, V%y")       \
+    X(SHL,      0xf00f, 0x800e, "SHL V%x {, V%y}")     \
+    X(SNE_REG,  0xf00f, 0x9000, "SNE V%x, V%y")        \
+    X(LD_I,     0xf000, 0xa000, "LD I, %nnn")          \
+    X(JP_V0,    0xf000, 0xb000, "JP V0, %nnn")         \
+    X(RND,      0xf000, 0xc000, "RND V%x, %kk")        \
+    X(DRW16,    0xf00f, 0xd000, "DRW V%x, V%y, 0")     \
+    X(DRW,      0xf000, 0xd000, "DRW V%x, V%y, %n")    \
+    X(SKP,      0xf0ff, 0xe09e, "SKP V%x")             \
+    X(SKNP,     0xf0ff, 0xe0a1, "SKNP V%x")            \
+    X(LD_I_LONG,0xffff, 0xf000, "LD I, %nnnn")         \
+    X(PLANE,    0xf0ff, 0xf001, "PLANE %x")            \
+    X(AUDIO,    0xffff, 0xf002, "AUDIO")               \
+    X(LD_VX_DT, 0xf0ff, 0xf007, "LD V%x, DT")          \
+    X(LD_VX_K,  0xf0ff, 0xf00a, "LD V%x, K")           \
+    X(LD_DT_VX, 0xf0ff, 0xf015, "LD DT, V%x")          \
+    X(LD_ST_VX, 0xf0ff, 0xf018, "LD ST, V%x")          \
+    X(ADD_I,    0xf0ff, 0xf01e, "ADD I, V%x")          \
+    X(LD_F,     0xf0ff, 0xf029, "LD F, V%x")           \
+    X(LD_HF,    0xf0ff, 0xf030, "LD HF, V%x")          \
+    X(LD_B,     0xf0ff, 0xf033, "LD B, V%x")           \
+    X(PITCH,    0xf0ff, 0xf03a, "PITCH V%x")           \
+    X(LD_MEM,   0xf0ff, 0xf055, "LD [I], V%x")         \
+    X(LD_REGS,  0xf0ff, 0xf065, "LD V%x, [I]")         \
+    X(LD_R_VX,  0xf0ff, 0xf075, "LD R, V%x")           \
+    X(LD_VX_R,  0xf0ff, 0xf085, "LD V%x, R")
+
+#define CHIP8_OPCODE_ENUM(name, mask, pattern, format) CHIP8_OP_##name,
+
+enum chip8_op
+{
+    CHIP8_OP_UNKNOWN,
+    CHIP8_OPCODE_TABLE(CHIP8_OPCODE_ENUM)
+    CHIP8_TOTAL_OPS
+};
+
+struct chip8_opcode
+{
+    unsigned short mask;
+    unsigned short pattern;
+    const char *format;
+};
+
+/* Indexed by enum chip8_op. */
+extern const struct chip8_opcode chip8_opcodes[CHIP8_TOTAL_OPS];
+
+/* Every 16-bit opcode resolved to its enum chip8_op. */
+extern unsigned char chip8_opcode_lookup[0x10000];
+
+/* Fills chip8_opcode_lookup from the table, once. chip8_init calls this, 
+anything decoding before a chip8 was initialised has to call it itself. Safe 
+to call from several threads at once. */
+void chip8_opcodes_init(void);
+
+static inline enum chip8_op chip8_decode(unsigned short opcode)
+{
+    return (enum chip8_op)chip8_opcode_lookup[opcode];
+}
+
+/* Returns the length of the instruction in bytes. */
+static inline int chip8_opcode_size(unsigned short opcode)
+{
+    return opcode == 0xf000 ? 4 : 2;
+}
+
+#endif
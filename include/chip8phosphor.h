@@ -0,0 +1,39 @@
+#ifndef CHIP8PHOSPHOR_H
+#define CHIP8PHOSPHOR_H
+
+#include <stddef.h>
+
+/*
+Sprites are moved by erasing them with XOR and drawing them again, so they
+are often missing from the frame shown and flicker. Phosphor persistence
+keeps them on screen: each output byte fades from its last level by a fixed
+factor per frame rather than going dark at once, like the glow of a CRT.
+
+Images are levels from 0 to 255, one byte per channel, each faded on its
+own, so the same code serves greyscale video and the window's ARGB pixels.
+It only changes what is shown, never the emulated screen.
+*/
+
+struct chip8_phosphor
+{
+    /* The levels shown last frame. */
+    unsigned char *levels;
+    size_t size;
+
+    /* How much of a level is left after a frame, in 256ths. */
+    int decay;
+};
+
+/* Images hold "size" bytes, "persistence" is the percentage of a level
+left after a frame, 0 to 99. Returns 0 on success and -1 on error. */
+int chip8_phosphor_init(struct chip8_phosphor *phosphor, size_t size,
+                        int persistence);
+
+/* Replaces each level of "image" by the faded level shown last frame when
+that is brighter. */
+void chip8_phosphor_blend(struct chip8_phosphor *phosphor,
+                          unsigned char *image);
+
+void chip8_phosphor_free(struct chip8_phosphor *phosphor);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef CHIP8POOL_H
+#define CHIP8POOL_H
+
+#include <stddef.h>
+
+/*
+A pool of threads for the tools that run many independent jobs, such as
+chip8-diff and chip8-golden. Each thread takes the next job index until
+none are left, working in a zeroed workspace of its own that it reuses from
+one job to the next.
+*/
+
+#define CHIP8_POOL_MAX_THREADS 64
+
+/* Calls work(workspace, i) once for every i below "count", on up to 
+"threads" threads. Returns 0 once every job ran, or -1 when some never 
+did because no thread could be started or given a workspace. */
+int chip8_pool_run(int threads, int count, size_t workspace_size,
+                   void (*work)(void *workspace, int index));
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef CHIP8PROFILE_H
+#define CHIP8PROFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "config.h"
+#include "chip8.h"
+
+/*
+The profiler attributes every instruction executed to the subroutine that
+ran it, following 2nnn (CALL) and 00EE (RET) through the stack pointer with
+a shadow call stack. Counts are kept per call path, a tree of subroutine
+addresses starting from the entry point, so they can be written as the
+collapsed stacks flame graph tools read:
+
+    200;2A4;310 1234
+
+one line per path whose last subroutine executed instructions itself, with
+how many. For each subroutine the summary gives its exclusive count, the
+instructions it executed, and its inclusive count, adding those of
+everything it called.
+*/
+
+struct chip8_profile_node
+{
+    unsigned short address;
+    int parent;
+    int first_child;
+    int next_sibling;
+
+    /* Instructions executed with this path on the stack. */
+    unsigned long long self;
+};
+
+struct chip8_profile
+{
+    /* The tree of call paths, the entry point being node 0. Children are
+    always after their parent. */
+    struct chip8_profile_node *nodes;
+    int count;
+    int capacity;
+
+    /* The path running now, and the SP it runs at. */
+    int current;
+    unsigned char sp;
+
+    /* Set when memory ran out, calls are then counted in the caller. 
+    "untracked" is how deep the calls left in the caller go, returns 
+    unwind them before leaving the caller. */
+    bool truncated;
+    int untracked;
+};
+
+/* Starts profiling at the chip8's current PC. Returns 0 on success and -1
+on error. */
+int chip8_profile_init(struct chip8_profile *profile,
+                       const struct chip8 *chip8);
+
+/* Attributes the instruction just executed, then follows a call or return
+it made. */
+void chip8_profile_record(struct chip8_profile *profile,
+                          const struct chip8 *chip8);
+
+/* chip8_run_frame, recording every instruction. */
+enum chip8_stop_reason chip8_profile_run_frame(struct chip8_profile *profile,
+                                               struct chip8 *chip8);
+
+/* Writes the collapsed stacks. Returns 0 on success and -1 on error. */
+int chip8_profile_write(const struct chip8_profile *profile, FILE *file);
+
+/* Prints the "count" subroutines with the highest inclusive counts. */
+void chip8_profile_print_summary(const struct chip8_profile *profile,
+                                 FILE *file, int count);
+
+void chip8_profile_free(struct chip8_profile *profile);
+
+#endif
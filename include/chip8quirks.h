@@ -0,0 +1,43 @@
+#ifndef CHIP8QUIRKS_H
+#define CHIP8QUIRKS_H
+
+/*
+Instructions whose behaviour differs between the original COSMAC VIP
+interpreter, SUPER-CHIP and XO-CHIP. Each quirk is one bit of a profile, a
+profile of 0 is the behaviour this emulator always had.
+
+chip8_exec and chip8_run are compiled once for every combination of quirks
+and pick the right core from the profile, so a quirk costs nothing per
+instruction.
+*/
+
+/* 8xy6 and 8xyE shift Vy into Vx instead of shifting Vx in place. */
+#define CHIP8_QUIRK_SHIFT_VY        0x01
+
+/* Fx55 and Fx65 leave I pointing past the last register. */
+#define CHIP8_QUIRK_LOAD_STORE_I    0x02
+
+/* Bnnn jumps to nnn + Vx, x being the top nibble of nnn. */
+#define CHIP8_QUIRK_JUMP_VX         0x04
+
+/* 8xy1, 8xy2 and 8xy3 clear VF. */
+#define CHIP8_QUIRK_VF_RESET        0x08
+
+#define CHIP8_TOTAL_QUIRK_PROFILES  0x10
+
+#define CHIP8_PROFILE_DEFAULT       0
+#define CHIP8_PROFILE_COSMAC        (CHIP8_QUIRK_SHIFT_VY | \
+                                     CHIP8_QUIRK_LOAD_STORE_I | \
+                                     CHIP8_QUIRK_VF_RESET)
+#define CHIP8_PROFILE_SCHIP         CHIP8_QUIRK_JUMP_VX
+#define CHIP8_PROFILE_XOCHIP        (CHIP8_QUIRK_SHIFT_VY | \
+                                     CHIP8_QUIRK_LOAD_STORE_I)
+
+/* Returns the profile called "name" ("default", "cosmac", "schip" or
+"xochip"), or a number of quirk bits, or -1 when neither. */
+int chip8_quirks_parse(const char *name);
+
+/* Returns the name of the profile, or NULL for other combinations. */
+const char *chip8_quirks_name(int quirks);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef CHIP8RECORDER_H
+#define CHIP8RECORDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "SDL2/SDL.h"
+#include "config.h"
+#include "chip8screen.h"
+
+/*
+Records the screen as an animated GIF. The emulation thread copies each 
+frame into a single producer, single consumer ring and returns, a worker 
+thread encodes it. A frame is never waited for: when the ring is full it is 
+dropped and the previous frame shows for longer.
+
+The GIF is CHIP8_HIRES_WIDTH x CHIP8_HIRES_HEIGHT times "scale", low 
+resolution pixels count double. Identical frames are merged into one longer 
+frame, the others only store the rectangle that changed.
+*/
+
+struct chip8_recorder_frame
+{
+    unsigned long long number;
+    bool hires;
+    uint64_t rows[CHIP8_TOTAL_PLANES][CHIP8_HIRES_HEIGHT]
+                 [CHIP8_SCREEN_ROW_WORDS];
+};
+
+struct chip8_recorder
+{
+    /* Written by the emulation thread only. */
+    SDL_atomic_t head;
+    unsigned long long dropped;
+
+    /* Set by the emulation thread in chip8_recorder_close, the worker reads 
+    it once the queue is empty and then finishes the file. */
+    SDL_atomic_t stop;
+
+    /* Written by the worker only. */
+    SDL_atomic_t tail;
+    int error;
+
+    /* Set by chip8_recorder_open before the worker starts. The file is 
+    only written by the worker until chip8_recorder_close has joined it. */
+    SDL_Thread *thread;
+    FILE *file;
+    int scale;
+
+    struct chip8_recorder_frame frames[CHIP8_RECORDER_QUEUE_SIZE];
+};
+
+/* Returns 0 on success and -1 on error. */
+int chip8_recorder_open(struct chip8_recorder *recorder, const char *filename,
+                        int scale);
+
+/* Queues the screen as frame "number", counted at 60Hz from the start of the
+recording. Never blocks. */
+void chip8_recorder_push(struct chip8_recorder *recorder, 
+                         const struct chip8_screen *screen, 
+                         unsigned long long number);
+
+/* Encodes the queued frames and finishes the file. Returns 0 on success and 
+-1 if anything failed to be written. */
+int chip8_recorder_close(struct chip8_recorder *recorder);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CHIP8REF_H
+#define CHIP8REF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "chip8.h"
+
+/*
+A reference model of the original Chip-8 instruction set, written to be
+obviously right rather than fast, against which chip8-diff checks the real
+interpreter. It follows Cowgod's Chip-8 technical reference (quoted in
+chip8.c) with the default quirk profile, and leaves alone anything that
+document doesn't describe:
+
+    CHIP8_REF_UNSUPPORTED  SUPER-CHIP and XO-CHIP instructions, and opcodes
+                           the reference doesn't list.
+    CHIP8_REF_UNDEFINED    Stack overflow or underflow, and memory accesses
+                           past the end of memory.
+
+chip8_ref_step changes nothing when it returns either, so a comparison can
+stop right before the instruction.
+
+Where the reference leaves room, the model does what this emulator does:
+the font is at CHIP8_CHARACTER_SET_LOAD_ADDRESS, SKP and SKNP use the low
+nibble of Vx, Fx0A runs again until a key is down and takes the lowest one,
+and RND draws from the generator of chip8_seed.
+*/
+
+enum chip8_ref_result
+{
+    CHIP8_REF_OK,
+    CHIP8_REF_UNSUPPORTED,
+    CHIP8_REF_UNDEFINED
+};
+
+struct chip8_ref
+{
+    unsigned char memory[CHIP8_MEMORY_SIZE];
+    unsigned char V[CHIP8_TOTAL_DATA_REGISTERS];
+    unsigned short I;
+    unsigned short PC;
+    unsigned char SP;
+    unsigned short stack[CHIP8_TOTAL_STACK_DEPTH];
+    unsigned char delay_timer;
+    unsigned char sound_timer;
+    bool display[CHIP8_HEIGHT][CHIP8_WIDTH];
+    bool keys[CHIP8_TOTAL_KEYS];
+    uint32_t random;
+};
+
+/* Copies the state of "chip8", which must be in the 64x32 mode showing the
+first plane only. */
+void chip8_ref_from_chip8(struct chip8_ref *ref, const struct chip8 *chip8);
+
+/* Executes the instruction at PC. */
+enum chip8_ref_result chip8_ref_step(struct chip8_ref *ref);
+
+/* Counts the timers down, once per 60Hz frame. */
+void chip8_ref_tick(struct chip8_ref *ref);
+
+/* Hashes the whole state, the same states always giving the same hash. */
+uint64_t chip8_ref_hash(const struct chip8_ref *ref);
+
+#endif
@@ -2,6 +2,32 @@
 #define CHIP8REGISTERS_H
 
 #include "config.h"
+
+/* The delay and sound timers count down once per 60Hz frame. Rather than 
+being decremented every frame, a timer keeps the value last written and the 
+frame it was written in, and its value is worked out when read. */
+struct chip8_timer
+{
+    unsigned char value;
+    unsigned long long frame;
+};
+
+/* Returns the value of the timer once "frame" frames have ended. */
+static inline unsigned char chip8_timer_get(const struct chip8_timer *timer,
+                                            unsigned long long frame)
+{
+    unsigned long long elapsed = frame - timer->frame;
+    return elapsed < timer->value ? timer->value - elapsed : 0;
+}
+
+static inline void chip8_timer_set(struct chip8_timer *timer, 
+                                   unsigned char value, 
+                                   unsigned long long frame)
+{
+    timer->value = value;
+    timer->frame = frame;
+}
+
 struct chip8_registers
 {
     /* Chip-8 has 16 general purpose 8-bit registers, 
@@ -17,9 +43,9 @@ struct chip8_registers
     unsigned short I;
 
     /* Chip-8 also has two special purpose 8-bit registers, for the delay and 
-    sound timers. */
-    unsigned char delay_timer;
-    unsigned char sound_timer;
+    sound timers. Read them with chip8_delay_timer and chip8_sound_timer. */
+    struct chip8_timer delay_timer;
+    struct chip8_timer sound_timer;
 
     /* There are also some "pseudo-registers" which are not accessable from 
     Chip-8 programs. The program counter (PC) should be 16-bit, and is used to 
@@ -0,0 +1,80 @@
+#ifndef CHIP8ROM_H
+#define CHIP8ROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+/*
+ROMs are mapped into memory rather than read, and chip8_load copies them 
+straight from the mapping into the chip8 memory. Sizes are checked before 
+anything is mapped.
+
+An archive packs many ROMs into one file. All numbers are little-endian:
+
+    "C8PK"  uint32 count
+    count x { char name[CHIP8_ROM_ARCHIVE_NAME_SIZE]; uint32 offset, size; }
+    ROM data
+
+Names are zero padded, offsets are from the start of the file.
+*/
+
+enum chip8_rom_error
+{
+    CHIP8_ROM_OK,
+    CHIP8_ROM_ERROR_OPEN,       /* The file can't be opened or mapped. */
+    CHIP8_ROM_ERROR_EMPTY,
+    CHIP8_ROM_ERROR_TOO_LARGE,  /* Doesn't fit the Chip-8 address space. */
+    CHIP8_ROM_ERROR_ARCHIVE,    /* Not an archive, or a corrupt one. */
+    CHIP8_ROM_ERROR_NOT_FOUND,  /* No ROM of that name in the archive. */
+    CHIP8_ROM_ERROR_WRITE
+};
+
+struct chip8_rom
+{
+    const unsigned char *data;
+    size_t size;
+};
+
+/* A mapped file, holding one ROM or an archive. */
+struct chip8_rom_file
+{
+    const unsigned char *data;
+    size_t size;
+    void *mapping;
+};
+
+struct chip8_rom_archive
+{
+    struct chip8_rom_file file;
+    uint32_t count;
+};
+
+const char *chip8_rom_error_string(int error);
+
+/* All functions returning int return CHIP8_ROM_OK or an enum 
+chip8_rom_error. */
+int chip8_rom_validate(size_t size);
+
+/* Maps a single ROM, "rom" then points into "file" until it's closed. */
+int chip8_rom_open(struct chip8_rom_file *file, const char *filename, 
+                   struct chip8_rom *rom);
+void chip8_rom_close(struct chip8_rom_file *file);
+
+/* Maps an archive and checks every entry of its directory, so the lookups 
+below can't fail on a corrupt file. */
+int chip8_rom_archive_open(struct chip8_rom_archive *archive, 
+                           const char *filename);
+int chip8_rom_archive_find(struct chip8_rom_archive *archive, 
+                           const char *name, struct chip8_rom *rom);
+
+/* Returns the name of the index'th ROM and points "rom" to its data. */
+const char *chip8_rom_archive_get(struct chip8_rom_archive *archive, 
+                                  uint32_t index, struct chip8_rom *rom);
+void chip8_rom_archive_close(struct chip8_rom_archive *archive);
+
+/* Packs "count" ROMs into a new archive. */
+int chip8_rom_archive_write(const char *filename, const char *const *names,
+                            const struct chip8_rom *roms, uint32_t count);
+
+#endif
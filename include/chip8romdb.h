@@ -0,0 +1,38 @@
+#ifndef CHIP8ROMDB_H
+#define CHIP8ROMDB_H
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+Per ROM settings, found by the xxHash64 of the ROM (see chip8hash.h). The
+built-in table covers the programs shipped in bin/. An override file adds
+entries or replaces built-in ones, one ROM per line:
+
+    # hash            profile  instructions-per-frame  [key map]
+    85652bcc92e412c0  default  7                       x123qweasdzc4rfv
+
+The profile is a name or number accepted by chip8_quirks_parse. The key map
+lists the host key for each of the keys 0 to F, "-" or nothing keeps the
+default.
+*/
+struct chip8_romdb_entry
+{
+    uint64_t hash;
+    const char *name;
+    unsigned char quirks;
+    unsigned short instructions_per_frame;
+
+    /* CHIP8_TOTAL_KEYS host keys, or NULL for the default map. */
+    const char *keyboard_map;
+};
+
+/* Returns the settings for the ROM with this hash, overrides first, or NULL 
+when the ROM is unknown. */
+const struct chip8_romdb_entry *chip8_romdb_find(uint64_t hash);
+
+/* Reads an override file. Returns 0, or -1 when the file can't be opened or 
+has an invalid line, in which case no entry of it is used. */
+int chip8_romdb_load_overrides(const char *filename);
+
+#endif
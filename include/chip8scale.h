@@ -0,0 +1,48 @@
+#ifndef CHIP8SCALE_H
+#define CHIP8SCALE_H
+
+#include "config.h"
+#include "chip8screen.h"
+
+/*
+Upscaling filters for the output, run on the CPU. Scale2x and Scale3x (also
+known as AdvMAME2x and AdvMAME3x) enlarge each pixel into a 2x2 or 3x3 block
+which takes the colour of a neighbour where the neighbours show a diagonal
+edge, so staircases become smooth lines while straight edges and single
+pixels stay sharp. They only ever copy colours, never blend them, which
+suits the four colour screen.
+
+Images are one byte per pixel holding its colour (0 to 3, see
+chip8screen.h), CHIP8_HIRES_WIDTH x CHIP8_HIRES_HEIGHT times the factor of
+the filter. Low resolution screens are filtered at their own resolution
+then enlarged twice as much, by Scale2x again for Scale2x and by Scale2x
+after Scale3x for Scale3x, so both modes fill the same image.
+
+With SSE2 sixteen pixels are compared at once, otherwise each on its own.
+*/
+
+enum chip8_scale_filter
+{
+    CHIP8_SCALE_NONE,           /* Each pixel becomes a block. */
+    CHIP8_SCALE_2X,
+    CHIP8_SCALE_3X
+};
+
+#define CHIP8_SCALE_MAX_FACTOR 3
+#define CHIP8_SCALE_MAX_SIZE (CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT * \
+                              CHIP8_SCALE_MAX_FACTOR * CHIP8_SCALE_MAX_FACTOR)
+
+/* Returns the filter called "name" ("none", "scale2x" or "scale3x"), or -1
+when there is none. */
+int chip8_scale_parse(const char *name);
+
+/* Returns 1, 2 or 3. */
+int chip8_scale_factor(enum chip8_scale_filter filter);
+
+/* Renders the screen into "image", CHIP8_HIRES_WIDTH x CHIP8_HIRES_HEIGHT
+times the factor of the filter. */
+void chip8_scale_render(enum chip8_scale_filter filter,
+                        const struct chip8_screen *screen,
+                        unsigned char *image);
+
+#endif
@@ -2,17 +2,69 @@
 #define CHIP8SCREEN_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "config.h"
 
-struct chip8_screen 
+/*
+The screen is stored one bit per pixel. Each row is CHIP8_SCREEN_ROW_WORDS
+64-bit words, the leftmost pixel of a word being its most significant bit, so
+sprites are drawn and the screen is scrolled a whole row at a time with shifts
+and XORs.
+
+In the original 64x32 mode only the first word of the first 32 rows is used.
+The SUPER-CHIP high resolution mode uses the full 128x64.
+
+XO-CHIP adds a second bitplane, so a pixel has one of four colours. Drawing, 
+clearing and scrolling only affect the planes selected with Fn01.
+*/
+struct chip8_screen
 {
-    bool pixels[CHIP8_HEIGHT][CHIP8_WIDTH];
+    bool hires;
+
+    /* Bit n selects plane n. */
+    unsigned char planes;
+    uint64_t rows[CHIP8_TOTAL_PLANES][CHIP8_HIRES_HEIGHT]
+                 [CHIP8_SCREEN_ROW_WORDS];
+
+#ifdef CHIP8_INCREMENTAL_HASH
+    /* The XOR of chip8_zobrist(word index, word) over "rows". Sprites update
+    it word by word, the rarer clears and scrolls compute it again. */
+    uint64_t hash;
+#endif
 };
 
+/* Clears all planes and selects the first one only. */
+void chip8_screen_init(struct chip8_screen *screen);
+
 void chip8_screen_clear(struct chip8_screen *screen);
 void chip8_screen_set(struct chip8_screen *screen, int x, int y);
 _Bool chip8_screen_is_set(struct chip8_screen *screen, int x, int y);
+
+/* Returns the colour of a pixel, bit n being its value in plane n. */
+int chip8_screen_get(struct chip8_screen *screen, int x, int y);
+void chip8_screen_select_planes(struct chip8_screen *screen, int planes);
+
+/* Sprites hold "num" bytes for each selected plane, one after the other. */
 bool chip8_screen_draw_sprite(struct chip8_screen *screen, int x, int y,
                               const char *sprite, int num);
-    
+
+/* Draws the 16x16 sprite of SUPER-CHIP's Dxy0, two bytes per row. */
+bool chip8_screen_draw_sprite16(struct chip8_screen *screen, int x, int y,
+                                const char *sprite);
+
+/* Switches between 64x32 and 128x64, clearing the screen. */
+void chip8_screen_set_hires(struct chip8_screen *screen, bool hires);
+int chip8_screen_width(struct chip8_screen *screen);
+int chip8_screen_height(struct chip8_screen *screen);
+
+#ifdef CHIP8_INCREMENTAL_HASH
+void chip8_screen_rehash(struct chip8_screen *screen);
+#endif
+
+/* Scroll by pixels of the current resolution, uncovered pixels are clear. */
+void chip8_screen_scroll_down(struct chip8_screen *screen, int num);
+void chip8_screen_scroll_up(struct chip8_screen *screen, int num);
+void chip8_screen_scroll_right(struct chip8_screen *screen, int num);
+void chip8_screen_scroll_left(struct chip8_screen *screen, int num);
+
 #endif
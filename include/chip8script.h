@@ -0,0 +1,59 @@
+#ifndef CHIP8SCRIPT_H
+#define CHIP8SCRIPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Input scripts hold the keys down during each frame, so a session can be
+played again exactly. Each line is "FRAME KEYS", the frame in decimal and
+the keys as a hexadecimal mask with bit n for Chip-8 key n. The keys stay
+down until the frame of the next line, frames before the first line have
+none. Lines starting with '#' are comments.
+*/
+
+struct chip8_script_entry
+{
+    unsigned long frame;
+    uint16_t keys;
+};
+
+struct chip8_script
+{
+    struct chip8_script_entry *entries;
+    int count;
+
+    /* The entry chip8_script_keys looks at next. */
+    int next;
+    uint16_t keys;
+};
+
+struct chip8_script_writer
+{
+    FILE *file;
+    bool started;
+    uint16_t keys;
+};
+
+/* Reads a script, frames must be increasing. Returns 0 on success and -1
+on error. */
+int chip8_script_load(struct chip8_script *script, const char *filename);
+
+/* Returns the keys down during "frame", asked for in increasing order. */
+uint16_t chip8_script_keys(struct chip8_script *script, unsigned long frame);
+
+void chip8_script_free(struct chip8_script *script);
+
+/* Returns 0 on success and -1 on error. */
+int chip8_script_create(struct chip8_script_writer *writer,
+                        const char *filename);
+
+/* Records the keys down during "frame", writing a line when they change. */
+void chip8_script_write(struct chip8_script_writer *writer,
+                        unsigned long frame, uint16_t keys);
+
+/* Returns 0 on success and -1 when the script couldn't be written. */
+int chip8_script_close(struct chip8_script_writer *writer);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef CHIP8SHM_H
+#define CHIP8SHM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "config.h"
+#include "chip8.h"
+
+/*
+A shared memory segment through which other processes watch and play a
+running emulator without sockets or serialisation. The emulator publishes
+its screen and registers after every frame, the other side writes the keys
+it holds.
+
+The state is guarded by a sequence lock: the emulator makes "sequence" odd
+while it writes and even again when done. Readers copy the state, or read it
+in place, and start again when "sequence" was odd or changed meanwhile. A
+reader waiting for the next frame polls "sequence". "keys" is a single word
+the emulator reads atomically once per frame, a set bit n holding Chip-8 key
+n down.
+
+The segment is named "/NAME" with shm_open, or "NAME" with
+CreateFileMapping on Windows, and laid out in native byte order as
+struct chip8_shm_segment, "keys" and "sequence" on separate cache lines.
+*/
+
+#define CHIP8_SHM_MAGIC 0x4d533843      /* "C8SM" */
+#define CHIP8_SHM_VERSION 1
+#define CHIP8_SHM_CACHE_LINE 64
+
+struct chip8_shm_state
+{
+    /* Frames published since the emulator started. */
+    uint64_t frame;
+    uint64_t rows[CHIP8_TOTAL_PLANES][CHIP8_HIRES_HEIGHT]
+                 [CHIP8_SCREEN_ROW_WORDS];
+    uint16_t stack[CHIP8_TOTAL_STACK_DEPTH];
+    uint16_t I;
+    uint16_t PC;
+    uint16_t keyboard;      /* The keys held during the frame. */
+    uint8_t V[CHIP8_TOTAL_DATA_REGISTERS];
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t SP;
+    uint8_t hires;
+};
+
+struct chip8_shm_segment
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keys;
+    uint8_t reserved[CHIP8_SHM_CACHE_LINE - 12];
+
+    uint32_t sequence;
+    uint8_t reserved2[CHIP8_SHM_CACHE_LINE - 4];
+
+    struct chip8_shm_state state;
+};
+
+struct chip8_shm
+{
+    struct chip8_shm_segment *segment;
+    void *mapping;
+    bool owner;
+    char name[64];
+    uint16_t keys;
+};
+
+/* Creates the segment as the emulator. Returns 0 on success and -1 on
+error. */
+int chip8_shm_create(struct chip8_shm *shm, const char *name);
+
+/* Copies the chip8 state into the segment. */
+void chip8_shm_publish(struct chip8_shm *shm, const struct chip8 *chip8,
+                       uint64_t frame);
+
+/* Presses and releases keys to match what the other side holds. Keys it
+didn't change are left alone, so the local keyboard keeps working. */
+void chip8_shm_apply_keys(struct chip8_shm *shm, struct chip8 *chip8);
+
+/* Attaches to the segment of a running emulator. Returns 0 on success and
+-1 on error. */
+int chip8_shm_attach(struct chip8_shm *shm, const char *name);
+
+/* Copies a consistent state, returning false before the first frame. */
+bool chip8_shm_read(struct chip8_shm *shm, struct chip8_shm_state *state);
+
+void chip8_shm_set_keys(struct chip8_shm *shm, uint16_t keys);
+
+/* Unmaps the segment, the emulator also removes it. */
+void chip8_shm_close(struct chip8_shm *shm);
+
+#endif
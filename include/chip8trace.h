@@ -0,0 +1,127 @@
+#ifndef CHIP8TRACE_H
+#define CHIP8TRACE_H
+
+/*
+Execution trace file format.
+
+A trace is a header followed by a stream of delta-encoded records and, when the
+writer was closed cleanly, an index footer:
+
++----------------------+
+| "C8TR" version ival  |  Header, 12 bytes (little endian 32-bit fields).
++----------------------+
+| record               |  count delta  - varint
+| record               |  PC delta     - zigzag varint (relative to PC + 2)
+| ...                  |  opcode       - 2 bytes, big endian as in memory
+|                      |  V mask       - varint, one bit per changed register
+|                      |  V values     - one byte per set bit in the mask
++----------------------+
+| index entries        |  (instruction count, file offset), 16 bytes each.
++----------------------+
+| "C8TI" offset count  |  Trailer, 20 bytes.
++----------------------+
+
+Every "ival" records the delta base is reset, count, PC and registers 
+alike, so the record that follows is absolute and decoding can start there: 
+its V mask lists every register that isn't 0. Those records are the 
+checkpoints listed in the index, which is what makes seeking O(log n).
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+#include "config.h"
+
+/* Version 1 traces didn't reset the registers at checkpoints. */
+#define CHIP8_TRACE_VERSION 2
+#define CHIP8_TRACE_HEADER_SIZE 12
+#define CHIP8_TRACE_TRAILER_SIZE 20
+#define CHIP8_TRACE_INDEX_ENTRY_SIZE 16
+
+struct chip8_trace
+{
+    FILE *file;
+    unsigned char buffer[CHIP8_TRACE_BUFFER_SIZE];
+    size_t used;
+
+    /* Position of the next record in the file, used to build the index. */
+    unsigned long long offset;
+    unsigned long records;
+
+    /* Delta base of the previous record. */
+    unsigned long long last_count;
+    unsigned short last_pc;
+    unsigned char last_V[CHIP8_TOTAL_DATA_REGISTERS];
+
+    /* Checkpoint index, kept in memory until the trace is closed. */
+    unsigned long long *index;
+    size_t index_count;
+    size_t index_capacity;
+
+    /* Set when the index ran out of memory. Entry k must be checkpoint k, 
+    so none are added after that and the trace is closed without a footer, 
+    leaving the reader to rebuild the index. */
+    bool unindexed;
+};
+
+struct chip8_trace_record
+{
+    unsigned long long count;
+    unsigned short pc;
+    unsigned short opcode;
+
+    /* Bit n is set when Vn was changed by the instruction, or at a 
+    checkpoint when Vn isn't 0. V holds every register, as decoded from the 
+    last checkpoint on. */
+    unsigned short changed;
+    unsigned char V[CHIP8_TOTAL_DATA_REGISTERS];
+};
+
+struct chip8_trace_reader
+{
+    const unsigned char *data;
+    size_t size;
+    void *mapping;
+
+    /* Records live in [CHIP8_TRACE_HEADER_SIZE, end). */
+    size_t end;
+    size_t pos;
+    unsigned long interval;
+
+    /* Index inside the mapped file, or a rebuilt copy when "owned" is set. */
+    const unsigned char *index;
+    size_t index_count;
+    int owned;
+
+    unsigned long long last_count;
+    unsigned short last_pc;
+    unsigned char last_V[CHIP8_TOTAL_DATA_REGISTERS];
+    unsigned long record;
+};
+
+/* Writer. All functions returning int return 0 on success and -1 on error. */
+int chip8_trace_open(struct chip8_trace *trace, const char *filename);
+
+/* Appends a record for the instruction "opcode" fetched from "pc". "V" are the
+registers after the instruction was executed. */
+void chip8_trace_record(struct chip8_trace *trace, unsigned long long count,
+                        unsigned short pc, unsigned short opcode,
+                        const unsigned char *V);
+int chip8_trace_close(struct chip8_trace *trace);
+
+/* Reader. */
+int chip8_trace_reader_open(struct chip8_trace_reader *reader,
+                            const char *filename);
+
+/* Positions the reader on the first record whose instruction count is equal
+or greater than "count". */
+int chip8_trace_reader_seek(struct chip8_trace_reader *reader,
+                            unsigned long long count);
+
+/* Returns 1 when a record was decoded, 0 at the end of the trace and -1 when
+the trace is corrupt. */
+int chip8_trace_reader_next(struct chip8_trace_reader *reader,
+                            struct chip8_trace_record *record);
+void chip8_trace_reader_close(struct chip8_trace_reader *reader);
+
+#endif
@@ -4,19 +4,76 @@
 #define EMULATOR_WINDOW_TITLE "Chip8 Emulator"
 
 /* The Chip-8 language is capable of accessing up to 4KB (4,096 bytes) of RAM, 
-from location 0x000 (0) to 0xFFF (4095).*/
-#define CHIP8_MEMORY_SIZE 4096
+from location 0x000 (0) to 0xFFF (4095). XO-CHIP extends this to the full 
+64KB a 16-bit I register can address. */
+#define CHIP8_MEMORY_SIZE 0x10000
 
 /* The original implementation of the Chip-8 language used a 64x32-pixel 
 monochrome display. */
 #define CHIP8_WIDTH 64
 #define CHIP8_HEIGHT 32
+
+/* SUPER-CHIP adds a 128x64-pixel high resolution mode. */
+#define CHIP8_HIRES_WIDTH 128
+#define CHIP8_HIRES_HEIGHT 64
+#define CHIP8_SCREEN_ROW_WORDS (CHIP8_HIRES_WIDTH / 64)
+
+/* XO-CHIP draws to two bitplanes, giving four colours. */
+#define CHIP8_TOTAL_PLANES 2
 #define CHIP8_WINDOW_MULTIPLIER 10
 #define CHIP8_TOTAL_DATA_REGISTERS 16
 #define CHIP8_TOTAL_STACK_DEPTH 16
 #define CHIP8_PROGRAM_LOAD_ADDRESS 0x200
+#define CHIP8_MAX_PROGRAM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_LOAD_ADDRESS)
+#define CHIP8_ROM_ARCHIVE_NAME_SIZE 24
 #define CHIP8_CHARACTER_SET_LOAD_ADDRESS 0x00
 #define CHIP8_TOTAL_KEYS 16
 #define CHIP8_DEFAULT_SPRITE_HEIGHT 5
 
+/* SUPER-CHIP's 8x10 font ends the interpreter area, away from the default 
+font, as some programs point Fx29 past "F" and expect blank memory. The 
+interpreter also keeps user flags (the HP48 "RPL" flags), SUPER-CHIP has 8 
+and XO-CHIP 16. */
+#define CHIP8_LARGE_CHARACTER_SET_LOAD_ADDRESS 0x160
+#define CHIP8_LARGE_SPRITE_HEIGHT 10
+#define CHIP8_TOTAL_RPL_FLAGS 16
+
+/* XO-CHIP plays a 128-bit pattern, one bit per sample, at 
+4000 * 2 ^ ((pitch - 64) / 48) samples per second. */
+#define CHIP8_AUDIO_PATTERN_SIZE 16
+#define CHIP8_AUDIO_DEFAULT_PITCH 64
+
+/* Execution traces are written through a buffer of this size, and a seekable 
+checkpoint is emitted every CHIP8_TRACE_CHECKPOINT_INTERVAL records. */
+#define CHIP8_TRACE_BUFFER_SIZE 65536
+#define CHIP8_TRACE_CHECKPOINT_INTERVAL 4096
+
+/* Debugger limits. Watchpoints are first tested against a bitmap with one bit 
+per CHIP8_WATCH_PAGE_SIZE bytes. */
+#define CHIP8_TOTAL_BREAKPOINTS 64
+#define CHIP8_TOTAL_WATCHPOINTS 16
+#define CHIP8_WATCH_PAGE_SIZE 256
+
+/* Memory keeps bitmaps of the code executed and the bytes written, with one 
+bit per CHIP8_CODE_BLOCK_SIZE bytes, to catch programs modifying their own 
+code. Larger blocks also catch data written next to code. */
+#define CHIP8_CODE_BLOCK_SIZE 8
+
+/* Timers count down and the screen is presented at 60Hz. ROMs missing from 
+the ROM database run CHIP8_DEFAULT_INSTRUCTIONS_PER_FRAME instructions per 
+frame. */
+#define CHIP8_FRAMES_PER_SECOND 60
+#define CHIP8_DEFAULT_INSTRUCTIONS_PER_FRAME 10
+#define CHIP8_ROMDB_MAX_OVERRIDES 256
+
+/* Frames queued for the GIF recorder, a power of two. About a second. */
+#define CHIP8_RECORDER_QUEUE_SIZE 64
+
+/* Netplay runs at most CHIP8_NETPLAY_MAX_ROLLBACK frames ahead of the peer's
+input and keeps that many snapshots. Inputs are kept for 
+CHIP8_NETPLAY_INPUT_HISTORY frames, a power of two of at least four times 
+the rollback. */
+#define CHIP8_NETPLAY_MAX_ROLLBACK 8
+#define CHIP8_NETPLAY_INPUT_HISTORY 32
+
 #endif
@@ -1,10 +1,10 @@
 #include "chip8.h"
+#include "chip8opcodes.h"
+#include "chip8hash.h"
+#include "chip8romdb.h"
 #include <memory.h>
-#include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <time.h>
-#include "SDL2/SDL.h"
 
 const char chip8_default_character_set[] = 
 {
@@ -26,9 +26,44 @@ const char chip8_default_character_set[] =
     0xf0, 0x80, 0xf0, 0x80, 0x80,          /* "F" */
 };
 
+/* SUPER-CHIP's 8x10 digits, used by Fx30. */
+const char chip8_large_character_set[] = 
+{
+    0xff, 0xff, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xff, 0xff,  /* "0" */
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xff, 0xff,  /* "1" */
+    0xff, 0xff, 0x03, 0x03, 0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff,  /* "2" */
+    0xff, 0xff, 0x03, 0x03, 0xff, 0xff, 0x03, 0x03, 0xff, 0xff,  /* "3" */
+    0xc3, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0x03, 0x03, 0x03, 0x03,  /* "4" */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0x03, 0x03, 0xff, 0xff,  /* "5" */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff,  /* "6" */
+    0xff, 0xff, 0x03, 0x03, 0x06, 0x0c, 0x18, 0x18, 0x18, 0x18,  /* "7" */
+    0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff,  /* "8" */
+    0xff, 0xff, 0xc3, 0xc3, 0xff, 0xff, 0x03, 0x03, 0xff, 0xff,  /* "9" */
+    0x7e, 0xff, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xc3,  /* "A" */
+    0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc, 0xc3, 0xc3, 0xfc, 0xfc,  /* "B" */
+    0x3c, 0xff, 0xc3, 0xc0, 0xc0, 0xc0, 0xc0, 0xc3, 0xff, 0x3c,  /* "C" */
+    0xfc, 0xfe, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xfe, 0xfc,  /* "D" */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff,  /* "E" */
+    0xff, 0xff, 0xc0, 0xc0, 0xff, 0xff, 0xc0, 0xc0, 0xc0, 0xc0,  /* "F" */
+};
+
+/* A square wave, for programs that never load an XO-CHIP audio pattern. */
+const unsigned char chip8_default_audio_pattern[CHIP8_AUDIO_PATTERN_SIZE] = 
+{
+    0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 
+    0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff
+};
+
 void chip8_init(struct chip8 *chip8)
 {
     memset(chip8, 0, sizeof(struct chip8));
+    chip8_opcodes_init();
+    chip8_screen_init(&chip8->screen);
+    chip8->pitch = CHIP8_AUDIO_DEFAULT_PITCH;
+    chip8->instructions_per_frame = CHIP8_DEFAULT_INSTRUCTIONS_PER_FRAME;
+    chip8_seed(chip8, 0);
+    memcpy(chip8->audio_pattern, chip8_default_audio_pattern, 
+           sizeof(chip8_default_audio_pattern));
     
     /* Copy the character set into the correct location in memory, as per:
     "Programs may also refer to a group of sprites representing the hexadecimal 
@@ -37,6 +72,11 @@ void chip8_init(struct chip8 *chip8)
     (0x000 to 0x1FF)." */
     memcpy(&chip8->memory.memory, chip8_default_character_set, 
                                   sizeof(chip8_default_character_set));
+    memcpy(&chip8->memory.memory[CHIP8_LARGE_CHARACTER_SET_LOAD_ADDRESS], 
+           chip8_large_character_set, sizeof(chip8_large_character_set));
+#ifdef CHIP8_INCREMENTAL_HASH
+    chip8_memory_rehash(&chip8->memory);
+#endif
 }
 
 /*
@@ -65,48 +105,280 @@ Memory Map:
 +---------------+= 0x000 (0) Start of Chip-8 RAM
 */
 
-void chip8_load(struct chip8 *chip8, const char *buf, size_t size)
+void chip8_seed(struct chip8 *chip8, uint32_t seed)
+{
+    /* xorshift never leaves 0, mix the seed so any value works. */
+    chip8->random = (seed ^ 0x9e3779b9) * 0x85ebca6b;
+    if (chip8->random == 0)
+        chip8->random = 1;
+}
+
+int chip8_load(struct chip8 *chip8, const char *buf, size_t size)
 {
     /* 0x200 (512) Start of most Chip-8 programs. */
-    assert(size + CHIP8_PROGRAM_LOAD_ADDRESS < CHIP8_MEMORY_SIZE);
+    int res = chip8_rom_validate(size);
+    if (res != CHIP8_ROM_OK)
+        return res;
     memcpy(&chip8->memory.memory[CHIP8_PROGRAM_LOAD_ADDRESS], buf, size);
+#ifdef CHIP8_INCREMENTAL_HASH
+    chip8_memory_rehash(&chip8->memory);
+#endif
     chip8->registers.PC = CHIP8_PROGRAM_LOAD_ADDRESS;
+
+    chip8->rom_hash = chip8_hash(buf, size, 0);
+    const struct chip8_romdb_entry *entry = chip8_romdb_find(chip8->rom_hash);
+    if (entry)
+    {
+        chip8->quirks = entry->quirks;
+        chip8->instructions_per_frame = entry->instructions_per_frame;
+        if (entry->keyboard_map)
+            chip8_keyboard_set_map(&chip8->keyboard, entry->keyboard_map);
+    }
+    return CHIP8_ROM_OK;
+}
+
+/* Returns the lowest key held down, or -1. */
+static int chip8_pressed_key(struct chip8 *chip8)
+{
+    for (int i = 0; i < CHIP8_TOTAL_KEYS; ++i)
+    {
+        if (chip8_keyboard_is_down(&chip8->keyboard, i))
+            return i;
+    }
+    return -1;
+}
+
+/* xorshift32, returns the next byte. */
+static unsigned char chip8_random(struct chip8 *chip8)
+{
+    uint32_t state = chip8->random;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    chip8->random = state;
+    return state >> 24;
+}
+
+/* Skips the next instruction, which is 4 bytes long for XO-CHIP's F000. */
+static void chip8_skip(struct chip8 *chip8)
+{
+    unsigned short next = chip8_memory_get_short(&chip8->memory, 
+                                                 chip8->registers.PC);
+    chip8->registers.PC += chip8_opcode_size(next);
 }
 
-static void chip8_exec_extended_eight(struct chip8 *chip8, 
-                                      unsigned short opcode)
+/* Returns the sprite at I, "size" bytes for each selected plane. A sprite
+running past the end of memory wraps around to its start like every other
+access through I, so it is copied into "wrapped" first. */
+static const char *chip8_sprite(struct chip8 *chip8, int size, 
+                                char *wrapped)
 {
+    int planes = (chip8->screen.planes & 1) + (chip8->screen.planes >> 1);
+    int I = chip8->registers.I;
+    if (I + size * planes <= CHIP8_MEMORY_SIZE)
+    {
+        return (const char *)&chip8->memory.memory[I];
+    }
+
+    for (int i = 0; i < size * planes; i++)
+    {
+        wrapped[i] = chip8_memory_get(&chip8->memory, I + i);
+    }
+    return wrapped;
+}
+
+/* GCC and MinGW inline this into every core even at -O0, the quirk tests 
+are then folded away at -O1 and above. */
+#if defined(__GNUC__)
+#define CHIP8_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define CHIP8_ALWAYS_INLINE __forceinline
+#else
+#define CHIP8_ALWAYS_INLINE inline
+#endif
+
+/* The interpreter itself. "quirks" is always a constant, see 
+CHIP8_DEFINE_CORE below. */
+static CHIP8_ALWAYS_INLINE void chip8_exec_core(struct chip8 *chip8, 
+                                                unsigned short opcode, 
+                                                const int quirks)
+{
+    /* 
+    nnn or addr - A 12-bit value, the lowest 12 bits of the instruction
+    n or nibble - A 4-bit value, the lowest 4 bits of the instruction
+    x - A 4-bit value, the lower 4 bits of the high byte of the instruction
+    y - A 4-bit value, the upper 4 bits of the low byte of the instruction
+    kk or byte - An 8-bit value, the lowest 8 bits of the instruction
+    */
+    unsigned short nnn = opcode & 0x0fff; 
     unsigned char x = (opcode >> 8) & 0x000f;
-    unsigned char y = (opcode >> 4) & 0x000f;    
-    unsigned char final_four_bits = opcode & 0x000f;  /* operation to run*/
+    unsigned char y = (opcode >> 4) & 0x000f;
+    unsigned char kk = opcode & 0x00ff;
+    unsigned char n = opcode & 0x000f;
     unsigned short tmp = 0;
-    switch(final_four_bits)
+
+    /* The opcode table in chip8opcodes.h is shared with the disassembler, so 
+    both always agree on what an opcode means. Unknown opcodes and 0nnn (SYS) 
+    are ignored. */
+    switch(chip8_decode(opcode))
     {
+        case CHIP8_OP_CLS:  /* 00E0 - CLS. Clear the display. */
+            chip8_screen_clear(&chip8->screen);
+        break;
+     
+        case CHIP8_OP_RET:  /* 00EE - RET. Return from the subroutine. */
+
+            /* The interpreter sets the program counter to the address at the 
+            top of the stack, then subtracts 1 from the stack pointer.*/
+            chip8->registers.PC = chip8_stack_pop(chip8); 
+        break;
+
+        case CHIP8_OP_SCD:  /* 00Cn - SCD nibble. Scroll down n lines. */
+            chip8_screen_scroll_down(&chip8->screen, n);
+        break;
+
+        case CHIP8_OP_SCU:  /* 00Dn - SCU nibble. Scroll up n lines. */
+            chip8_screen_scroll_up(&chip8->screen, n);
+        break;
+
+        case CHIP8_OP_SCR:  /* 00FB - SCR. Scroll display 4 pixels right. */
+            chip8_screen_scroll_right(&chip8->screen, 4);
+        break;
+
+        case CHIP8_OP_SCL:  /* 00FC - SCL. Scroll display 4 pixels left. */
+            chip8_screen_scroll_left(&chip8->screen, 4);
+        break;
+
+        case CHIP8_OP_EXIT:  /* 00FD - EXIT. Exit the interpreter. */
+
+            /* Stay on this instruction, chip8_run reports the exit. */
+            chip8->registers.PC -= 2;
+            chip8->exited = true;
+        break;
+
+        case CHIP8_OP_LOW:  /* 00FE - LOW. Disable extended screen mode. */
+            chip8_screen_set_hires(&chip8->screen, false);
+        break;
+
+        case CHIP8_OP_HIGH:  /* 00FF - HIGH. Enable extended screen mode. */
+            chip8_screen_set_hires(&chip8->screen, true);
+        break;
+
+        case CHIP8_OP_JP:  /* 1nnn - JP addr. Jump to location nnn */  
+
+            /* The interpreter sets the PC to nnn.*/  
+            chip8->registers.PC = nnn;            
+        break;
+        
+        case CHIP8_OP_CALL:  /* 2nnn - CALL addr. Call subroutine at nnn. */ 
+        {   
+            /* The interpreter increments the stack pointer, then puts the 
+            current PC on the top of the stack. The PC is then set to nnn.*/
+            chip8_stack_push(chip8, chip8->registers.PC);
+            chip8->registers.PC = nnn;
+        }
+        break;
+
+        case CHIP8_OP_SE_BYTE:  /* 3xkk - SE Vx, byte. Skip if Vx = kk. */
+        {
+            /*  The interpreter compares register Vx to kkk, and if they are 
+            equal, increments the program counter by 2.*/
+            if (chip8->registers.V[x] == kk)
+            {
+                chip8_skip(chip8);
+            }
+        }
+        break;
 
-        case 0x00:  /* 8xy0 - LD Vx, Vy. Set Vx = Vy. */
+        case CHIP8_OP_SNE_BYTE:  /* 4xkk -SNE Vx,byte. Skip if Vx != kk. */
+        {
+            /* The interpreter compares register Vx to kk, and if they are not 
+            equal, increments the program counter by 2.*/
+            if (chip8->registers.V[x] != kk)
+            {
+                chip8_skip(chip8);
+            }
+        }
+        break;
+
+        case CHIP8_OP_SE_REG:  /* 5xy0-SE Vx,Vy. Skip if Vx = Vy. */
+        {
+            /* The interpreter compares register Vx to register Vy, and if they 
+            are equal, increments the program counter by 2. */
+            if (chip8->registers.V[x] == chip8->registers.V[y])
+            {
+                chip8_skip(chip8);
+            }
+        }
+        break;
+
+        case CHIP8_OP_SAVE:  /* 5xy2 - SAVE Vx - Vy. Store Vx through Vy in 
+            memory starting at location I. */
+        {
+            /* I is not changed. When x > y the registers are stored in 
+            descending order, still starting at I. */
+            int step = x <= y ? 1 : -1;
+            for (int i = 0; i <= abs(x - y); i++)
+            {
+                chip8_memory_set(&chip8->memory, chip8->registers.I + i, 
+                                 chip8->registers.V[x + i * step]);
+            }
+        }
+        break;
+
+        case CHIP8_OP_LOAD:  /* 5xy3 - LOAD Vx - Vy. Read Vx through Vy from 
+            memory starting at location I. */
+        {
+            int step = x <= y ? 1 : -1;
+            for (int i = 0; i <= abs(x - y); i++)
+            {
+                chip8->registers.V[x + i * step] = chip8_memory_get(
+                    &chip8->memory, chip8->registers.I + i);
+            }
+        }
+        break;
+
+        case CHIP8_OP_LD_BYTE: /* 6xkk - LD Vx, byte. Set Vx = kk.*/ 
+
+            /* The interpreter puts the value kk into register Vx. */
+            chip8->registers.V[x] = kk;
+        break;
+
+        case CHIP8_OP_ADD_BYTE: /* 7xkk - ADD Vx, byte. Set Vx = Vx + kk. */
+
+            /* Adds the value kk to the value of register Vx, then stores the 
+            result in Vx. */
+            chip8->registers.V[x] += kk;
+        break;
+
+        case CHIP8_OP_LD_REG:  /* 8xy0 - LD Vx, Vy. Set Vx = Vy. */
             /* Stores the value of register Vy in register Vx. */
             chip8->registers.V[x] = chip8->registers.V[y];
         break;
 
-        case 0x01:  /* 8xy1 - OR Vx, Vy. Set Vx = Vx OR Vy. */ 
+        case CHIP8_OP_OR:  /* 8xy1 - OR Vx, Vy. Set Vx = Vx OR Vy. */ 
             /* Performs a bitwise OR on the values of Vx and Vy, then stores 
             the result in Vx. A bitwise OR compares the corrseponding bits from 
             two values, and if either bit is 1, then the same bit in the result 
             is also 1. Otherwise, it is 0. */
             chip8->registers.V[x] = (chip8->registers.V[x] | 
                                      chip8->registers.V[y]);
+            if (quirks & CHIP8_QUIRK_VF_RESET)
+                chip8->registers.V[0x0f] = 0;
         break;
 
-        case 0x02:  /* 8xy2 - AND Vx, Vy. Set Vx = Vx AND Vy.*/
+        case CHIP8_OP_AND:  /* 8xy2 - AND Vx, Vy. Set Vx = Vx AND Vy.*/
             /* Performs a bitwise AND on the values of Vx and Vy, then stores 
             the result in Vx. A bitwise AND compares the corrseponding bits 
             from two values, and if both bits are 1, then the same bit in the 
             result is also 1. Otherwise, it is 0. */
             chip8->registers.V[x] = (chip8->registers.V[x] & 
                                      chip8->registers.V[y]);    
+            if (quirks & CHIP8_QUIRK_VF_RESET)
+                chip8->registers.V[0x0f] = 0;
         break;
 
-        case 0x03:  /* 8xy3 - XOR Vx, Vy. Set Vx = Vx XOR Vy. */
+        case CHIP8_OP_XOR:  /* 8xy3 - XOR Vx, Vy. Set Vx = Vx XOR Vy. */
             /* Performs a bitwise exclusive OR on the values of Vx and Vy, then 
             stores the result in Vx. An exclusive OR compares the corrseponding 
             bits from two values, and if the bits are not both the same, then 
@@ -114,120 +386,232 @@ static void chip8_exec_extended_eight(struct chip8 *chip8,
             0. */
             chip8->registers.V[x] = (chip8->registers.V[x] ^ 
                                      chip8->registers.V[y]); 
+            if (quirks & CHIP8_QUIRK_VF_RESET)
+                chip8->registers.V[0x0f] = 0;
         break;
 
-        case 0x04:  /* 8xy4 - ADD Vx, Vy. Set Vx = Vx + Vy, set VF = carry. */
+        case CHIP8_OP_ADD_REG:  /* 8xy4 - ADD Vx, Vy. Set Vx = Vx + Vy, set 
+            VF = carry. */
         {    
             /* The values of Vx and Vy are added together. If the result is 
             greater than 8 bits (i.e., > 255,) VF is set to 1, otherwise 0. 
-            Only the lowest 8 bits of the result are kept, and stored in Vx. */
+            Only the lowest 8 bits of the result are kept, and stored in Vx. 
+            VF is written last so it holds the flag when x is F. */
             tmp = chip8->registers.V[x] + chip8->registers.V[y];
-            chip8->registers.V[0x0f] = false;
-            if (tmp > 0xff)
-            {
-                chip8->registers.V[0x0f] = true;
-            }
             chip8->registers.V[x] = tmp;
+            chip8->registers.V[0x0f] = (tmp > 0xff);
         }
         break;
 
-        case 0x05:  /* 8xy5 - SUB Vx, Vy. Set Vx = Vx-Vy, set VF =NOT borrow.*/
+        case CHIP8_OP_SUB:  /* 8xy5 - SUB Vx, Vy. Set Vx = Vx-Vy, set VF =NOT 
+            borrow.*/
         {    
-            /* If Vx > Vy, then VF is set to 1, otherwise 0. Then Vy is 
-            subtracted from Vx, and the results stored in Vx. */
-            chip8->registers.V[0x0f] = false;
-            if (chip8->registers.V[x] > chip8->registers.V[y])
-                chip8->registers.V[0x0f] = true;
+            /* If Vx >= Vy, then VF is set to 1, otherwise 0: equal values 
+            don't borrow. Then Vy is subtracted from Vx, and the results 
+            stored in Vx. The flag is stored after Vx, like for ADD. */
+            bool no_borrow = (chip8->registers.V[x] >= chip8->registers.V[y]);
             chip8->registers.V[x] -= chip8->registers.V[y];
+            chip8->registers.V[0x0f] = no_borrow;
         }
         break;
 
-        case 0x06:  /* 8xy6 - SHR Vx {, Vy}. Set Vx = Vx SHR 1. */
+        case CHIP8_OP_SHR:  /* 8xy6 - SHR Vx {, Vy}. Set Vx = Vx SHR 1. */
             
             /* If the least-significant bit of Vx is 1, then VF is set to 1, 
             otherwise 0. Then Vx is divided by 2. */
         {    
-            chip8->registers.V[0x0f] = chip8->registers.V[x] & 0b00000001;
-            chip8->registers.V[x] /= 2;
+            /* The COSMAC VIP shifts Vy and stores the result in Vx. */
+            unsigned char source = (quirks & CHIP8_QUIRK_SHIFT_VY) ? 
+                chip8->registers.V[y] : chip8->registers.V[x];
+            chip8->registers.V[x] = source / 2;
+            chip8->registers.V[0x0f] = source & 0b00000001;
         }
         break;
 
-        case 0x07:  /* 8xy7 - SUBN Vx, Vy. Set Vx=Vy - Vx, set VF=NOT borrow.*/
+        case CHIP8_OP_SUBN:  /* 8xy7 - SUBN Vx, Vy. Set Vx=Vy - Vx, set VF=NOT 
+            borrow.*/
         {    
-            /* If Vy > Vx, then VF is set to 1, otherwise 0. 
+            /* If Vy >= Vx, then VF is set to 1, otherwise 0. 
             Then Vx is subtracted from Vy, and the results stored in Vx.*/
-            chip8->registers.V[x] = (chip8->registers.V[y] > 
-                                     chip8->registers.V[x]);
+            bool no_borrow = (chip8->registers.V[y] >= chip8->registers.V[x]);
             chip8->registers.V[x] = (chip8->registers.V[y] - 
                                      chip8->registers.V[x]);
+            chip8->registers.V[0x0f] = no_borrow;
         }
         break; 
 
-        case 0x0E:  /* 8xyE - SHL Vx {, Vy}. Set Vx = Vx SHL 1. */
+        case CHIP8_OP_SHL:  /* 8xyE - SHL Vx {, Vy}. Set Vx = Vx SHL 1. */
         {    
             /* If the most-significant bit of Vx is 1, then VF is set to 1, 
             otherwise to 0. Then Vx is multiplied by 2. */
-            chip8->registers.V[0x0f] = chip8->registers.V[x] & 0b10000000;
-            chip8->registers.V[x] *= 2;
+            unsigned char source = (quirks & CHIP8_QUIRK_SHIFT_VY) ? 
+                chip8->registers.V[y] : chip8->registers.V[x];
+            chip8->registers.V[x] = source * 2;
+            chip8->registers.V[0x0f] = source >> 7;
         }
         break;
-    }
-}
 
-static char chip8_wait_for_key_press(struct chip8 *chip8)
-{
-    SDL_Event event;
-    while(SDL_WaitEvent(&event))
-    {
-        if (event.type != SDL_KEYDOWN)
-            continue;
+        case CHIP8_OP_SNE_REG:  /* 9xy0 - SNE Vx,Vy. Skip if Vx != Vy.*/
+        {
+            /* The values of Vx and Vy are compared, and if they are not equal, 
+            the program counter is increased by 2 */
+            if (chip8->registers.V[x] != chip8->registers.V[y])
+            {
+                chip8_skip(chip8);
+            }
+        }            
+        break;  
+
+        case CHIP8_OP_LD_I:  /* Annn - LD I, addr. Set I = nnn. */
+
+            /* The value of register I is set to nnn. */   
+            chip8->registers.I = nnn; 
+        break;
+
+        case CHIP8_OP_JP_V0:  /* Bnnn - JP V0, addr. Jump to nnn + V0. */
+
+            /* The program counter is set to nnn plus the value of V0. 
+            SUPER-CHIP adds Vx instead, x being the top nibble of nnn. */
+            if (quirks & CHIP8_QUIRK_JUMP_VX)
+                chip8->registers.PC = nnn + chip8->registers.V[x];
+            else
+                chip8->registers.PC = nnn + chip8->registers.V[0x00];
+        break;
 
-        char c = event.key.keysym.sym;
-        char chip8_key = chip8_keyboard_map(&chip8->keyboard, c);
-        if (chip8_key != -1)
+        case CHIP8_OP_RND:  /* Cxkk - RND Vx, byte. Set Vx = random AND kk. */
         {
-            return chip8_key;
+            /* The interpreter generates a random number from 0 to 255, which 
+            is then ANDed with the value kk. The results are stored in Vx. 
+            See instruction 8xy2 for more information on AND. */
+
+            /* The generator is part of the chip8 state, so a restored 
+            snapshot replays the same numbers. */
+            chip8->registers.V[x] = chip8_random(chip8) & kk;
         }
-    }    
-    return(-1);
-}
+        break;
 
-static void chip8_exec_extended_F(struct chip8 *chip8, unsigned short opcode)
-{
-    unsigned char x = (opcode >> 8) & 0x000f;
-    switch (opcode & 0x00ff)
-    {
-        case 0x07:  /* Fx07 - LD Vx, DT. Set Vx = delay timer value. */
+        case CHIP8_OP_DRW:  /* Dxyn - DRW Vx, Vy, nibble.  */
+            /* Display n-byte sprite starting at memory location I at (Vx, Vy), 
+            set VF = collision. */
+
+            /* The interpreter reads n bytes from memory, starting at the 
+            address stored in I. These bytes are then displayed as sprites on 
+            screen at coordinates (Vx, Vy). Sprites are XORed onto the existing 
+            screen. If this causes any pixels to be erased, VF is set to 1, 
+            otherwise it is set to 0. If the sprite is positioned so part of it 
+            is outside the coordinates of the display, it wraps around to the 
+            opposite side of the screen. See instruction 8xy3 for more 
+            information on XOR, and section 2.4, Display, for more information 
+            on the Chip-8 screen and sprites. */
+            {
+                char wrapped[16 * CHIP8_TOTAL_PLANES];
+                const char *sprite = chip8_sprite(chip8, n, wrapped);
+                chip8->registers.V[0x0f] = chip8_screen_draw_sprite(
+                    &chip8->screen, chip8->registers.V[x], 
+                    chip8->registers.V[y], sprite, n);
+            }
+        break;
+
+        case CHIP8_OP_DRW16:  /* Dxy0 - DRW Vx, Vy, 0. Draw a 16x16 sprite. */
+            {
+                /* The sprite is 32 bytes, two bytes per row. */
+                char wrapped[32 * CHIP8_TOTAL_PLANES];
+                const char *sprite = chip8_sprite(chip8, 32, wrapped);
+                chip8->registers.V[0x0f] = chip8_screen_draw_sprite16(
+                    &chip8->screen, chip8->registers.V[x], 
+                    chip8->registers.V[y], sprite);
+            }
+        break;
+
+        /* Ex9E - SKP Vx. Skip next instruction if key with the value of Vx is 
+        pressed.  */
+        case CHIP8_OP_SKP:
+        {
+            /* Checks the keyboard, and if the key corresponding to the value 
+            of Vx is currently in the down position, PC is increased by 2. 
+            Only the low nibble selects a key, as on the COSMAC VIP. */
+            if (chip8_keyboard_is_down(&chip8->keyboard, 
+                                       chip8->registers.V[x] & 0x0f))
+                chip8_skip(chip8);
+        }
+        break;
+
+        /* ExA1 - SKNP Vx. Skip next instruction if key with the value of Vx is 
+        not pressed. */
+        case CHIP8_OP_SKNP:
+        {
+            /* Checks the keyboard, and if the key corresponding to the value 
+            of Vx is currently in the up position, PC is increased by 2. */
+            if (!chip8_keyboard_is_down(&chip8->keyboard, 
+                                        chip8->registers.V[x] & 0x0f))
+            {
+                chip8_skip(chip8);
+            }
+        }
+        break;
+
+        case CHIP8_OP_LD_I_LONG:  /* F000 nnnn - LD I, long. Set I = nnnn. */
+
+            /* The only 4-byte instruction, the address follows the opcode. */
+            chip8->registers.I = chip8_memory_get_short(&chip8->memory, 
+                                                        chip8->registers.PC);
+            chip8_memory_mark_executed(&chip8->memory, chip8->registers.PC);
+            chip8->registers.PC += 2;
+        break;
+
+        case CHIP8_OP_PLANE:  /* Fn01 - PLANE n. Select the drawing planes. */
+            chip8_screen_select_planes(&chip8->screen, x);
+        break;
+
+        case CHIP8_OP_AUDIO:  /* F002 - AUDIO. Load the audio pattern. */
+
+            /* The 16 bytes at I become the pattern played while the sound 
+            timer is active. */
+            for (int i = 0; i < CHIP8_AUDIO_PATTERN_SIZE; i++)
+            {
+                chip8->audio_pattern[i] = chip8_memory_get(&chip8->memory, 
+                                                       chip8->registers.I + i);
+            }
+        break;
+
+        case CHIP8_OP_LD_VX_DT:  /* Fx07 - LD Vx, DT. Set Vx = delay timer. */
         {
             /* The value of DT is placed into Vx. */
-            chip8->registers.V[x] = chip8->registers.delay_timer;
+            chip8->registers.V[x] = chip8_delay_timer(chip8);
         }
         break;
 
-        case 0x0A:  /* Fx0A - LD Vx, K. Wait for a key press, store the value 
-            of the key in Vx.*/
+        case CHIP8_OP_LD_VX_K:  /* Fx0A - LD Vx, K. Wait for a key press, store 
+            the value of the key in Vx.*/
         {
             /* All execution stops until a key is pressed, then the value of 
-            that key is stored in Vx.*/
-            char pressed_key = chip8_wait_for_key_press(chip8);
-            chip8->registers.V[x] = pressed_key;
+            that key is stored in Vx. Rather than blocking, the instruction 
+            runs again until a key is down, so the frontend keeps handling 
+            events and a headless host never hangs. */
+            int pressed_key = chip8_pressed_key(chip8);
+            if (pressed_key < 0)
+                chip8->registers.PC -= 2;
+            else
+                chip8->registers.V[x] = pressed_key;
         }
         break;
 
-        case 0x15:  /* Fx15 - LD DT, Vx. Set delay timer = Vx.*/ 
+        case CHIP8_OP_LD_DT_VX:  /* Fx15 - LD DT, Vx. Set delay timer = Vx.*/ 
         {
             /* DT is set equal to the value of Vx. */
-            chip8->registers.delay_timer = chip8->registers.V[x];            
+            chip8_timer_set(&chip8->registers.delay_timer, 
+                            chip8->registers.V[x], chip8->frames);
         }
         break;
 
-        case 0x18:  /* Fx18 - LD ST, Vx. Set sound timer = Vx. */
+        case CHIP8_OP_LD_ST_VX:  /* Fx18 - LD ST, Vx. Set sound timer = Vx. */
 
             /* ST is set equal to the value of Vx. */
-            chip8->registers.sound_timer = chip8->registers.V[x];
+            chip8_timer_set(&chip8->registers.sound_timer, 
+                            chip8->registers.V[x], chip8->frames);
         break;
 
-        case 0x1E:  /* Fx1E - ADD I, Vx. Set I = I + Vx. */ 
+        case CHIP8_OP_ADD_I:  /* Fx1E - ADD I, Vx. Set I = I + Vx. */ 
         {
             /* The values of I and Vx are added, and the results are stored 
             in I.*/
@@ -235,7 +619,8 @@ static void chip8_exec_extended_F(struct chip8 *chip8, unsigned short opcode)
         }
         break;
 
-        case 0x29:  /* Fx29 - LD F,Vx. Set I=location of sprite for digit Vx.*/
+        case CHIP8_OP_LD_F:  /* Fx29 - LD F,Vx. Set I=location of sprite for 
+            digit Vx.*/
 
             /* The value of I is set to the location for the hexadecimal sprite 
             corresponding to the value of Vx. See section 2.4, Display, for 
@@ -244,8 +629,19 @@ static void chip8_exec_extended_F(struct chip8 *chip8, unsigned short opcode)
                                  CHIP8_DEFAULT_SPRITE_HEIGHT;
         break;
 
-        case 0x33:  /* Fx33 - LD B, Vx. Store BCD representation of Vx in 
-            memory locations I, I+1, and I+2. */
+        case CHIP8_OP_LD_HF:  /* Fx30 - LD HF, Vx. Set I = location of the 
+            8x10 sprite for digit Vx. */
+            chip8->registers.I = CHIP8_LARGE_CHARACTER_SET_LOAD_ADDRESS + 
+                                 (chip8->registers.V[x] & 0x0f) * 
+                                 CHIP8_LARGE_SPRITE_HEIGHT;
+        break;
+
+        case CHIP8_OP_PITCH:  /* Fx3A - PITCH Vx. Set the audio pitch = Vx. */
+            chip8->pitch = chip8->registers.V[x];
+        break;
+
+        case CHIP8_OP_LD_B:  /* Fx33 - LD B, Vx. Store BCD representation of Vx 
+            in memory locations I, I+1, and I+2. */
         {
             /* The interpreter takes the decimal value of Vx, and places the 
             hundreds digit in memory at location in I, the tens digit at 
@@ -257,9 +653,10 @@ static void chip8_exec_extended_F(struct chip8 *chip8, unsigned short opcode)
             chip8_memory_set(&chip8->memory, chip8->registers.I + 1, tens);
             chip8_memory_set(&chip8->memory, chip8->registers.I + 2, units);
         }
-    
-        case 0x55:  /* Fx55 - LD [I],Vx. Store registers V0 through Vx in 
-            memory starting at location I.  */
+        break;
+
+        case CHIP8_OP_LD_MEM:  /* Fx55 - LD [I],Vx. Store registers V0 through 
+            Vx in memory starting at location I.  */
         {
             /* The interpreter copies the values of registers V0 through Vx 
             into memory, starting at the address in I.*/
@@ -268,11 +665,13 @@ static void chip8_exec_extended_F(struct chip8 *chip8, unsigned short opcode)
                 chip8_memory_set(&chip8->memory, chip8->registers.I + i, 
                                                         chip8->registers.V[i]);
             }
+            if (quirks & CHIP8_QUIRK_LOAD_STORE_I)
+                chip8->registers.I += x + 1;
         }
         break;
 
-        case 0x65:  /* Fx65-LD Vx,[I]. Read registers V0 through Vx from memory 
-            starting at location I.  */
+        case CHIP8_OP_LD_REGS:  /* Fx65-LD Vx,[I]. Read registers V0 through Vx 
+            from memory starting at location I.  */
         {
             /* The interpreter reads values from memory starting at location I 
             into registers V0 through Vx. */
@@ -281,208 +680,225 @@ static void chip8_exec_extended_F(struct chip8 *chip8, unsigned short opcode)
                 chip8->registers.V[i] = chip8_memory_get(&chip8->memory, 
                                                        chip8->registers.I + i);
             }
+            if (quirks & CHIP8_QUIRK_LOAD_STORE_I)
+                chip8->registers.I += x + 1;
         }
         break;
-    }
-}
 
-static void chip8_exec_extended(struct chip8 *chip8, unsigned short opcode)
-{
-    /* 
-    nnn or addr - A 12-bit value, the lowest 12 bits of the instruction
-    n or nibble - A 4-bit value, the lowest 4 bits of the instruction
-    x - A 4-bit value, the lower 4 bits of the high byte of the instruction
-    y - A 4-bit value, the upper 4 bits of the low byte of the instruction
-    kk or byte - An 8-bit value, the lowest 8 bits of the instruction
-    */
-    unsigned short nnn = opcode & 0x0fff; 
-    unsigned char x = (opcode >> 8) & 0x000f;
-    unsigned char y = (opcode >> 4) & 0x000f;
-    unsigned char kk = opcode & 0x00ff;
-    unsigned char n = opcode & 0x000f;
-    switch(opcode & 0xf000)  /* We see only the first four bits. */
-    {
-        
-        case 0x1000:  /* 1nnn - JP addr. Jump to location nnn */  
-
-            /* The interpreter sets the PC to nnn.*/  
-            chip8->registers.PC = nnn;            
-        break;
-        
-        case 0x2000:  /* 2 nnn - CALL addr. Call subroutine at location nnn. */ 
-        {   
-            /* The interpreter increments the stack pointer, then puts the 
-            current PC on the top of the stack. The PC is then set to nnn.*/
-            chip8_stack_push(chip8, chip8->registers.PC);
-            chip8->registers.PC = nnn;
-        }
-        break;
-
-        case 0x3000:  /*3xkk - SE Vx, byte. Skip next instruction if Vx = kk.*/
-        {
-            /*  The interpreter compares register Vx to kkk, and if they are 
-            equal, increments the program counter by 2.*/
-            if (chip8->registers.V[x] == kk)
+        case CHIP8_OP_LD_R_VX:  /* Fx75 - LD R, Vx. Store V0 through Vx in 
+            the RPL user flags (x <= 7). */
+            for (int i = 0; i <= x && i < CHIP8_TOTAL_RPL_FLAGS; i++)
             {
-                chip8->registers.PC += 2;  /* Each instruction is 2 bytes. */
+                chip8->rpl[i] = chip8->registers.V[i];
             }
-        }
         break;
 
-        case 0x4000:  /*4xkk -SNE Vx,byte. Skip next instruction if Vx != kk.*/
-        {
-            /* The interpreter compares register Vx to kk, and if they are not 
-            equal, increments the program counter by 2.*/
-            if (chip8->registers.V[x] != kk)
+        case CHIP8_OP_LD_VX_R:  /* Fx85 - LD Vx, R. Read V0 through Vx from 
+            the RPL user flags (x <= 7). */
+            for (int i = 0; i <= x && i < CHIP8_TOTAL_RPL_FLAGS; i++)
             {
-                chip8->registers.PC += 2;
+                chip8->registers.V[i] = chip8->rpl[i];
             }
-        }
         break;
 
-        case 0x5000:  /* 5xy0-SE Vx,Vy. Skip next instruction if Vx = Vy. */
-        {
-            /* The interpreter compares register Vx to register Vy, and if they 
-            are equal, increments the program counter by 2. */
-            if (chip8->registers.V[x] == chip8->registers.V[y])
-            {
-                chip8->registers.PC += 2;
-            }
-        }
+        default:
         break;
+    }
+}
 
-        case 0x6000: /* 6xkk - LD Vx, byte. Set Vx = kk.*/ 
-
-            /* The interpreter puts the value kk into register Vx. */
-            chip8->registers.V[x] = kk;
-        break;
+/* Instantiates chip8_exec_N and chip8_run_N for the quirk profile N. */
+#define CHIP8_DEFINE_CORE(quirks) \
+    static void chip8_exec_##quirks(struct chip8 *chip8, \
+                                    unsigned short opcode) \
+    { \
+        chip8_exec_core(chip8, opcode, quirks); \
+    } \
+    static void chip8_run_##quirks(struct chip8 *chip8, int budget) \
+    { \
+        for (int i = 0; i < budget; ++i) \
+        { \
+            unsigned short opcode = chip8_memory_get_short(&chip8->memory, \
+                                                    chip8->registers.PC); \
+            chip8_memory_mark_executed(&chip8->memory, chip8->registers.PC); \
+            chip8->registers.PC += 2; \
+            chip8_exec_core(chip8, opcode, quirks); \
+            chip8->instruction_count++; \
+        } \
+    }
 
-        case 0x7000: /* 7xkk - ADD Vx, byte. Set Vx = Vx + kk. */
+CHIP8_DEFINE_CORE(0)  CHIP8_DEFINE_CORE(1)  CHIP8_DEFINE_CORE(2)
+CHIP8_DEFINE_CORE(3)  CHIP8_DEFINE_CORE(4)  CHIP8_DEFINE_CORE(5)
+CHIP8_DEFINE_CORE(6)  CHIP8_DEFINE_CORE(7)  CHIP8_DEFINE_CORE(8)
+CHIP8_DEFINE_CORE(9)  CHIP8_DEFINE_CORE(10) CHIP8_DEFINE_CORE(11)
+CHIP8_DEFINE_CORE(12) CHIP8_DEFINE_CORE(13) CHIP8_DEFINE_CORE(14)
+CHIP8_DEFINE_CORE(15)
 
-            /* Adds the value kk to the value of register Vx, then stores the 
-            result in Vx. */
-            chip8->registers.V[x] += kk;
-        break;
+static void (*const chip8_exec_cores[CHIP8_TOTAL_QUIRK_PROFILES])
+            (struct chip8 *, unsigned short) =
+{
+    chip8_exec_0,  chip8_exec_1,  chip8_exec_2,  chip8_exec_3,
+    chip8_exec_4,  chip8_exec_5,  chip8_exec_6,  chip8_exec_7,
+    chip8_exec_8,  chip8_exec_9,  chip8_exec_10, chip8_exec_11,
+    chip8_exec_12, chip8_exec_13, chip8_exec_14, chip8_exec_15
+};
 
-        case 0x8000:
-            chip8_exec_extended_eight(chip8, opcode);            
-        break;
+static void (*const chip8_run_cores[CHIP8_TOTAL_QUIRK_PROFILES])
+            (struct chip8 *, int) =
+{
+    chip8_run_0,  chip8_run_1,  chip8_run_2,  chip8_run_3,
+    chip8_run_4,  chip8_run_5,  chip8_run_6,  chip8_run_7,
+    chip8_run_8,  chip8_run_9,  chip8_run_10, chip8_run_11,
+    chip8_run_12, chip8_run_13, chip8_run_14, chip8_run_15
+};
 
-        case 0x9000:  /* 9xy0 - SNE Vx,Vy. Skip next instruction if Vx != Vy.*/
-        {
-            /* The values of Vx and Vy are compared, and if they are not equal, 
-            the program counter is increased by 2 */
-            if (chip8->registers.V[x] != chip8->registers.V[y])
-            {
-                chip8->registers.PC += 2;
-            }
-        }            
-        break;  
+void chip8_exec(struct chip8 *chip8, unsigned short opcode)
+{
+    chip8_exec_cores[chip8->quirks % CHIP8_TOTAL_QUIRK_PROFILES](chip8, 
+                                                                 opcode);
+}
 
-        case 0xA000:  /* Annn - LD I, addr. Set I = nnn. */
+void chip8_step(struct chip8 *chip8)
+{
+    /* Read the two bytes from memory where the program counter is pointing 
+    to. Return those two bytes as an opcode. */
+    unsigned short opcode = chip8_memory_get_short(&chip8->memory, 
+                                                   chip8->registers.PC);
+    chip8_memory_mark_executed(&chip8->memory, chip8->registers.PC);
+    
+    /* Increment the program counter. */
+    chip8->registers.PC += 2;
 
-            /* The value of register I is set to nnn. */   
-            chip8->registers.I = nnn; 
-        break;
+    /* Execute the opcode. */
+    chip8_exec(chip8, opcode);
+    chip8->instruction_count++;
+}
 
-        case 0xB000:  /* Bnnn - JP V0, addr. Jump to location nnn + V0. */
+/* Returns the address of the delay timer wait
 
-            /* The program counter is set to nnn plus the value of V0. */
-            chip8->registers.PC = nnn + chip8->registers.V[0x00];        
-        break;
+    a:  Fx07    LD Vx, DT
+        3x00    SE Vx, 0
+        1aaa    JP a
 
-        case 0xC000:  /* Cxkk - RND Vx, byte. Set Vx = random byte AND kk. */
+that PC is in, or -1. */
+static int chip8_delay_wait_start(struct chip8 *chip8)
+{
+    for (int offset = 0; offset <= 4; offset += 2)
+    {
+        /* JP only reaches the first 4KB. */
+        unsigned short start = chip8->registers.PC - offset;
+        if (start > 0x0fff)
+            continue;
+        unsigned short load = chip8_memory_get_short(&chip8->memory, start);
+        unsigned short x = load & 0x0f00;
+        if ((load & 0xf0ff) == 0xf007 &&
+            chip8_memory_get_short(&chip8->memory, start + 2) == 
+            (0x3000 | x) &&
+            chip8_memory_get_short(&chip8->memory, start + 4) == 
+            (0x1000 | start))
         {
-            /* The interpreter generates a random number from 0 to 255, which 
-            is then ANDed with the value kk. The results are stored in Vx. 
-            See instruction 8xy2 for more information on AND. */
-
-            /* seed for a random number generator*/ 
-            srand(clock());
-            chip8->registers.V[x] = (rand() % 255) & kk;         
+            return start;
         }
-        break;
-
-        case 0xD000:  /* Dxyn - DRW Vx, Vy, nibble.  */
-            /* Display n-byte sprite starting at memory location I at (Vx, Vy), 
-            set VF = collision. */
+    }
+    return -1;
+}
 
-            /* The interpreter reads n bytes from memory, starting at the 
-            address stored in I. These bytes are then displayed as sprites on 
-            screen at coordinates (Vx, Vy). Sprites are XORed onto the existing 
-            screen. If this causes any pixels to be erased, VF is set to 1, 
-            otherwise it is set to 0. If the sprite is positioned so part of it 
-            is outside the coordinates of the display, it wraps around to the 
-            opposite side of the screen. See instruction 8xy3 for more 
-            information on XOR, and section 2.4, Display, for more information 
-            on the Chip-8 screen and sprites. */
-            {
-                const char *sprite = (const char*) 
-                                     &chip8->memory.memory[chip8->registers.I];
-                chip8->registers.V[0x0f] = chip8_screen_draw_sprite(
-                    &chip8->screen, chip8->registers.V[x], 
-                    chip8->registers.V[y], sprite, n);
-            }
-        break;
+/* Programs idle either in a jump to itself, often once the game is over, 
+or in the delay timer wait, which doesn't change anything but Vx while the 
+timer is above 0. Whole iterations left in the budget are counted rather 
+than run, their code still marked executed. Returns how many instructions of 
+"budget" ran or were counted. */
+static int chip8_skip_idle(struct chip8 *chip8, 
+                           void (*run)(struct chip8 *, int), int budget)
+{
+    if (chip8->exited)
+        return 0;
+    unsigned short pc = chip8->registers.PC;
+    if (pc <= 0x0fff && 
+        chip8_memory_get_short(&chip8->memory, pc) == (0x1000 | pc))
+    {
+        chip8_memory_mark_executed(&chip8->memory, pc);
+        chip8->instruction_count += budget;
+        return budget;
+    }
 
-        case 0xE000:  /* Keyboard operations. */
-            {   
-                switch(opcode & 0x00ff)
-                {
-                    /* Ex9E - SKP Vx. Skip next instruction if key with the 
-                    value of Vx is pressed.  */
-                    case 0x9e:
-                    {
-                        /* Checks the keyboard, and if the key corresponding to 
-                        the value of Vx is currently in the down position, PC 
-                        is increased by 2. */
-                        if (chip8_keyboard_is_down(&chip8->keyboard, 
-                                                        chip8->registers.V[x]))
-                            chip8->registers.PC += 2;
-                    }
-                    break;
-
-                    /* ExA1 - SKNP Vx. Skip next instruction if key with the 
-                    value of Vx is not pressed. */
-                    case 0xa1:
-                    {
-                        /* Checks the keyboard, and if the key corresponding to 
-                        the value of Vx is currently in the up position, PC is 
-                        increased by 2. */
-                        if (!chip8_keyboard_is_down(&chip8->keyboard, 
-                                                        chip8->registers.V[x]))
-                        {
-                            chip8->registers.PC += 2;            
-                        }
-                    }
-                    break;
-                }
-            }            
-        break;
-
-        case 0xF000:  
-            chip8_exec_extended_F(chip8, opcode);
-        break;
+    int start = chip8_delay_wait_start(chip8);
+    if (start < 0)
+        return 0;
+
+    /* Run to the top of the loop, SE leaves it if Vx was read as 0. */
+    int lead = (6 - (unsigned short)(chip8->registers.PC - start)) % 6 / 2;
+    if (lead > budget)
+        return 0;
+    run(chip8, lead);
+    unsigned char delay = chip8_delay_timer(chip8);
+    if (chip8->registers.PC != start || delay == 0)
+        return lead;
+
+    int skipped = (budget - lead) / 3 * 3;
+    if (skipped > 0)
+    {
+        unsigned short load = chip8_memory_get_short(&chip8->memory, start);
+        chip8->registers.V[(load >> 8) & 0x0f] = delay;
+        chip8->instruction_count += skipped;
+        for (int offset = 0; offset <= 4; offset += 2)
+        {
+            chip8_memory_mark_executed(&chip8->memory, start + offset);
+        }
     }
+    return lead + skipped;
 }
 
-void chip8_exec(struct chip8 *chip8, unsigned short opcode)
+enum chip8_stop_reason chip8_run(struct chip8 *chip8, int budget)
 {
-    /* Standard Chip-8 Instructions. */
-    switch(opcode)
+    /* The profile is looked up once, not for every instruction. */
+    void (*run)(struct chip8 *, int) = 
+        chip8_run_cores[chip8->quirks % CHIP8_TOTAL_QUIRK_PROFILES];
+    budget -= chip8_skip_idle(chip8, run, budget);
+    run(chip8, budget);
+
+    /* Checked once per call rather than per instruction, an exited program 
+    just spins on its EXIT. */
+    return chip8->exited ? CHIP8_STOP_EXIT : CHIP8_STOP_BUDGET;
+}
+
+#ifdef CHIP8_INCREMENTAL_HASH
+uint64_t chip8_state_hash(const struct chip8 *chip8)
+{
+    /* Registers are written all over the interpreter and only take a few 
+    dozen bytes, so they are hashed here rather than kept up to date. */
+    const struct chip8_registers *registers = &chip8->registers;
+    unsigned short words[4 + CHIP8_TOTAL_STACK_DEPTH] =
     {
-        case 0x00E0:  /* CLS. Clear the display. */
-            chip8_screen_clear(&chip8->screen);
-        break;
-     
-        case 0x00EE:  /* RET. Return from the subroutine. */
+        registers->I, registers->PC, 
+        registers->SP | chip8_delay_timer(chip8) << 8,
+        chip8_sound_timer(chip8) | chip8->screen.hires << 8 | 
+        chip8->screen.planes << 9 | chip8->exited << 11 
+    };
+    memcpy(&words[4], chip8->stack.stack, sizeof(chip8->stack.stack));
+    unsigned char bytes[CHIP8_TOTAL_DATA_REGISTERS + CHIP8_TOTAL_RPL_FLAGS + 
+                        CHIP8_AUDIO_PATTERN_SIZE + 1];
+    memcpy(bytes, registers->V, CHIP8_TOTAL_DATA_REGISTERS);
+    memcpy(bytes + CHIP8_TOTAL_DATA_REGISTERS, chip8->rpl, 
+           CHIP8_TOTAL_RPL_FLAGS);
+    memcpy(bytes + CHIP8_TOTAL_DATA_REGISTERS + CHIP8_TOTAL_RPL_FLAGS, 
+           chip8->audio_pattern, CHIP8_AUDIO_PATTERN_SIZE);
+    bytes[sizeof(bytes) - 1] = chip8->pitch;
+
+    uint64_t hash = chip8_hash(words, sizeof(words), chip8->random);
+    hash = chip8_hash(bytes, sizeof(bytes), hash);
+    return hash ^ chip8->memory.hash ^ chip8_hash_mix(chip8->screen.hash);
+}
+#endif
 
-            /* The interpreter sets the program counter to the address at the 
-            top of the stack, then subtracts 1 from the stack pointer.*/
-            chip8->registers.PC = chip8_stack_pop(chip8); 
-        break;
+void chip8_end_frame(struct chip8 *chip8)
+{
+    chip8->frames++;
+}
 
-        default:
-            chip8_exec_extended(chip8, opcode); 
-    }
+enum chip8_stop_reason chip8_run_frame(struct chip8 *chip8)
+{
+    enum chip8_stop_reason reason = chip8_run(chip8, 
+                                              chip8->instructions_per_frame);
+    chip8_end_frame(chip8);
+    return reason;
 }
@@ -0,0 +1,25 @@
+#include "chip8audio.h"
+#include <math.h>
+
+#define CHIP8_AUDIO_PATTERN_BITS (CHIP8_AUDIO_PATTERN_SIZE * 8)
+
+void chip8_audio_render(struct chip8 *chip8, unsigned char *samples, 
+                        int count, int sample_rate, double *phase)
+{
+    /* XO-CHIP plays 4000 * 2 ^ ((pitch - 64) / 48) pattern bits a second. */
+    double rate = 4000.0 * pow(2.0, (chip8->pitch - 64) / 48.0);
+    double step = rate / sample_rate;
+    double pos = *phase;
+
+    for (int i = 0; i < count; ++i)
+    {
+        int bit = (int)pos;
+        int set = chip8->audio_pattern[bit / 8] & (0x80 >> (bit % 8));
+        samples[i] = set ? 0xc0 : 0x40;
+
+        pos += step;
+        if (pos >= CHIP8_AUDIO_PATTERN_BITS)
+            pos -= CHIP8_AUDIO_PATTERN_BITS;
+    }
+    *phase = pos;
+}
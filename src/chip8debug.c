@@ -0,0 +1,194 @@
+#include "chip8debug.h"
+#include "chip8opcodes.h"
+#include <memory.h>
+
+void chip8_debug_init(struct chip8_debugger *debugger)
+{
+    memset(debugger, 0, sizeof(struct chip8_debugger));
+}
+
+void chip8_debug_clear(struct chip8_debugger *debugger)
+{
+    chip8_debug_init(debugger);
+}
+
+int chip8_debug_add_breakpoint(struct chip8_debugger *debugger,
+                               const struct chip8_breakpoint *breakpoint)
+{
+    if (debugger->breakpoint_count == CHIP8_TOTAL_BREAKPOINTS ||
+        breakpoint->reg >= CHIP8_TOTAL_DATA_REGISTERS)
+    {
+        return -1;
+    }
+
+    debugger->breakpoints[debugger->breakpoint_count++] = *breakpoint;
+    debugger->breakpoint_map[breakpoint->address / 8] |=
+                                                1 << (breakpoint->address % 8);
+    return 0;
+}
+
+int chip8_debug_add_watchpoint(struct chip8_debugger *debugger,
+                               unsigned short start, unsigned short end)
+{
+    if (debugger->watchpoint_count == CHIP8_TOTAL_WATCHPOINTS ||
+        start > end)
+    {
+        return -1;
+    }
+
+    struct chip8_watchpoint *watchpoint;
+    watchpoint = &debugger->watchpoints[debugger->watchpoint_count++];
+    watchpoint->start = start;
+    watchpoint->end = end;
+    for (int page = start / CHIP8_WATCH_PAGE_SIZE;
+         page <= end / CHIP8_WATCH_PAGE_SIZE; ++page)
+    {
+        debugger->watch_map[page / 8] |= 1 << (page % 8);
+    }
+    return 0;
+}
+
+static bool chip8_debug_breakpoint_hit(struct chip8_debugger *debugger,
+                                       struct chip8 *chip8, unsigned short pc)
+{
+    if (!(debugger->breakpoint_map[pc / 8] & (1 << (pc % 8))))
+        return false;
+
+    for (int i = 0; i < debugger->breakpoint_count; ++i)
+    {
+        const struct chip8_breakpoint *bp = &debugger->breakpoints[i];
+        if (bp->address != pc)
+            continue;
+
+        unsigned char v = chip8->registers.V[bp->reg];
+        switch (bp->condition)
+        {
+            case CHIP8_CONDITION_ALWAYS:    return true;
+            case CHIP8_CONDITION_EQUAL:     if (v == bp->value) return true;
+            break;
+            case CHIP8_CONDITION_NOT_EQUAL: if (v != bp->value) return true;
+            break;
+            case CHIP8_CONDITION_LESS:      if (v < bp->value) return true;
+            break;
+            case CHIP8_CONDITION_GREATER:   if (v > bp->value) return true;
+            break;
+        }
+    }
+    return false;
+}
+
+/* Returns the range of memory "opcode" is about to write, if any. */
+static bool chip8_debug_write_range(struct chip8 *chip8, unsigned short opcode,
+                                    int *start, int *end)
+{
+    unsigned char x = (opcode >> 8) & 0x000f;
+    unsigned char y = (opcode >> 4) & 0x000f;
+    switch (chip8_decode(opcode))
+    {
+        case CHIP8_OP_SAVE:  /* 5xy2 - SAVE Vx - Vy. Writes I to I+|x-y|. */
+            *start = chip8->registers.I;
+            *end = chip8->registers.I + (x > y ? x - y : y - x);
+        return true;
+
+        case CHIP8_OP_LD_B:  /* Fx33 - LD B, Vx. Writes I to I+2. */
+            *start = chip8->registers.I;
+            *end = chip8->registers.I + 2;
+        return true;
+
+        case CHIP8_OP_LD_MEM:  /* Fx55 - LD [I], Vx. Writes I to I+x. */
+            *start = chip8->registers.I;
+            *end = chip8->registers.I + x;
+        return true;
+
+        default:
+        break;
+    }
+    return false;
+}
+
+/* Whether any watchpoint covers an address in [start, end], which lie 
+within memory. */
+static bool chip8_debug_range_watched(struct chip8_debugger *debugger,
+                                      int start, int end)
+{
+    /* Cheap page level test first, ranges only for watched pages. */
+    bool page_hit = false;
+    for (int a = start; a <= end; ++a)
+    {
+        int page = a / CHIP8_WATCH_PAGE_SIZE;
+        if (debugger->watch_map[page / 8] & (1 << (page % 8)))
+        {
+            page_hit = true;
+            break;
+        }
+    }
+    if (!page_hit)
+        return false;
+
+    for (int i = 0; i < debugger->watchpoint_count; ++i)
+    {
+        const struct chip8_watchpoint *wp = &debugger->watchpoints[i];
+        if (start <= wp->end && end >= wp->start)
+            return true;
+    }
+    return false;
+}
+
+static bool chip8_debug_watchpoint_hit(struct chip8_debugger *debugger,
+                                       struct chip8 *chip8,
+                                       unsigned short opcode)
+{
+    int start, end;
+    if (!chip8_debug_write_range(chip8, opcode, &start, &end))
+        return false;
+
+    /* Writes running past the end of memory wrap around to its start. */
+    if (end >= CHIP8_MEMORY_SIZE)
+    {
+        return chip8_debug_range_watched(debugger, start, 
+                                         CHIP8_MEMORY_SIZE - 1) ||
+               chip8_debug_range_watched(debugger, 0, 
+                                         end - CHIP8_MEMORY_SIZE);
+    }
+    return chip8_debug_range_watched(debugger, start, end);
+}
+
+enum chip8_stop_reason chip8_debug_run(struct chip8_debugger *debugger,
+                                       struct chip8 *chip8, int budget)
+{
+    /* Nothing to check, use the uninstrumented core. */
+    if (debugger->breakpoint_count == 0 && debugger->watchpoint_count == 0)
+        return chip8_run(chip8, budget);
+
+    bool check_watch = debugger->watchpoint_count != 0;
+    for (int i = 0; i < budget; ++i)
+    {
+        unsigned short pc = chip8->registers.PC;
+        if (debugger->resuming)
+        {
+            /* Step over whatever stopped us last time. */
+            debugger->resuming = false;
+        }
+        else
+        {
+            if (chip8_debug_breakpoint_hit(debugger, chip8, pc))
+            {
+                debugger->resuming = true;
+                return CHIP8_STOP_BREAKPOINT;
+            }
+
+            if (check_watch)
+            {
+                unsigned short opcode = chip8_memory_get_short(&chip8->memory,
+                                                               pc);
+                if (chip8_debug_watchpoint_hit(debugger, chip8, opcode))
+                {
+                    debugger->resuming = true;
+                    return CHIP8_STOP_WATCHPOINT;
+                }
+            }
+        }
+        chip8_step(chip8);
+    }
+    return chip8->exited ? CHIP8_STOP_EXIT : CHIP8_STOP_BUDGET;
+}
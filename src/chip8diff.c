@@ -0,0 +1,582 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8debug.h"
+#include "chip8disasm.h"
+#include "chip8pool.h"
+#include "chip8ref.h"
+#include "chip8rom.h"
+
+/*
+chip8-diff runs programs through the interpreter and the reference model of
+chip8ref.h in lockstep, to catch the interpreter going wrong:
+
+    chip8-diff [--frames N] [--random N] [--seed N] [--interval N]
+               [--threads N] [--core run|step|debug] [ROM...]
+
+Every ROM given and N random programs (256 by default) run for the given
+number of frames with pseudo-random keys, on as many threads. The state
+hashes of both are compared every "interval" instructions. When they differ
+the comparison bisects back to the first instruction after which they do,
+and prints it with both states. Registers are compared after every
+instruction, so the interpreter stops before a wrong SP or I trips one of
+its asserts. A program stops early, without failing, on
+instructions the reference leaves out.
+
+--core picks the interpreter under test: chip8_run, the quirk specialised
+core (the default), chip8_step through chip8_exec, or the instrumented core
+of chip8_debug_run. chip8_run is given whole frames, as the frontends do, so
+its idle loop skipping is compared too, and its registers are only compared
+at the end of each frame. Partial frames, which bisecting needs, are run
+with chip8_step. The exit status is 1 when any program diverged.
+*/
+
+#define DEFAULT_FRAMES 600
+#define DEFAULT_RANDOM_PROGRAMS 256
+#define DEFAULT_INTERVAL 1000
+
+/* Random programs are this many bytes of instructions at 0x200. */
+#define RANDOM_PROGRAM_SIZE 512
+
+/* Keys stay down this many frames. */
+#define KEY_HOLD_FRAMES 8
+
+/* Memory differences listed before giving up. */
+#define MAX_DUMPED_BYTES 16
+
+enum core
+{
+    CORE_RUN,
+    CORE_STEP,
+    CORE_DEBUG
+};
+
+struct job
+{
+    char name[64];
+    const char *filename;       /* NULL for random programs. */
+    uint32_t seed;
+};
+
+/* The interpreter and the model at the same point, "index" instructions
+into the program. */
+struct side
+{
+    struct chip8 chip8;
+    struct chip8_ref ref;
+    unsigned long long index;
+    enum chip8_ref_result stop;
+    bool finished;
+    bool diverged;
+};
+
+/* Everything one job needs, allocated once per thread. */
+struct workspace
+{
+    struct side current;
+    struct side checkpoint;
+    struct side probe;
+    struct chip8_ref converted;
+    struct chip8_debugger debugger;
+};
+
+static long frames = DEFAULT_FRAMES;
+static unsigned long long interval = DEFAULT_INTERVAL;
+static enum core core = CORE_RUN;
+
+static struct job *jobs;
+static int total_jobs;
+static int diverged;
+static pthread_mutex_t output = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint16_t job_keys(const struct job *job, long frame)
+{
+    uint32_t x = mix(job->seed * 0x9e3779b9 + frame / KEY_HOLD_FRAMES);
+    return x & (x >> 16);
+}
+
+/* Original Chip-8 instructions with random operands. Jumps and calls stay
+inside the program, I mostly points at the program or the font. The program
+calls its body again and again, so a RET goes back to the start rather than
+underflowing the stack. */
+static void random_program(uint32_t seed, unsigned char *program)
+{
+    static const unsigned short patterns[] =
+    {
+        0x00e0, 0x00ee, 0x1000, 0x2000, 0x3000, 0x4000, 0x5000, 0x6000,
+        0x7000, 0x8000, 0x8001, 0x8002, 0x8003, 0x8004, 0x8005, 0x8006,
+        0x8007, 0x800e, 0x9000, 0xa000, 0xb000, 0xc000, 0xd000, 0xe09e,
+        0xe0a1, 0xf007, 0xf00a, 0xf015, 0xf018, 0xf01e, 0xf029, 0xf033,
+        0xf055, 0xf065
+    };
+    int total = sizeof(patterns) / sizeof(patterns[0]);
+    static const unsigned char prologue[] =
+    {
+        0x22, 0x04,     /* CALL 204 */
+        0x12, 0x00      /* JP 200 */
+    };
+    memcpy(program, prologue, sizeof(prologue));
+    for (int i = sizeof(prologue); i < RANDOM_PROGRAM_SIZE; i += 2)
+    {
+        uint32_t r = mix(seed * 0x9e3779b9 + i);
+        unsigned short pattern = patterns[r % total];
+        unsigned short opcode = pattern;
+        unsigned short address = CHIP8_PROGRAM_LOAD_ADDRESS +
+                                 (r >> 8) % RANDOM_PROGRAM_SIZE;
+        switch (pattern >> 12)
+        {
+        case 0x1: case 0x2:
+            opcode |= address & ~1;
+            break;
+        case 0xa:
+            opcode |= r & 0x100000 ? (r >> 8) % 0x50 : address;
+            break;
+        case 0xb:
+            opcode |= address & 0x0f00;
+            break;
+        case 0x0:
+            break;
+        case 0xd:
+            opcode |= (r >> 8) & 0x0ff0;
+            opcode |= 1 + (r >> 20) % 15;
+            break;
+        case 0x5: case 0x8: case 0x9:
+            /* A quarter use one register twice, where comparisons and the 
+            borrow of SUB and SUBN are on their edge. Another quarter use 
+            VF as Vx, where the flag must overwrite the result. */
+            if ((r >> 28) % 4 == 0)
+                opcode |= ((r >> 8) & 0x0f) * 0x0110;
+            else if ((r >> 28) % 4 == 1)
+                opcode |= 0x0f00 | ((r >> 8) & 0x00f0);
+            else
+                opcode |= (r >> 8) & 0x0ff0;
+            break;
+        case 0xe: case 0xf:
+            opcode |= (r >> 8) & 0x0f00;
+            break;
+        default:
+            opcode |= (r >> 8) & 0x0fff;
+            break;
+        }
+        program[i] = opcode >> 8;
+        program[i + 1] = opcode & 0xff;
+    }
+}
+
+static bool registers_match(const struct side *side)
+{
+    const struct chip8_registers *registers = &side->chip8.registers;
+    const struct chip8_ref *ref = &side->ref;
+    return memcmp(registers->V, ref->V, sizeof(ref->V)) == 0 &&
+           registers->I == ref->I && registers->PC == ref->PC &&
+           registers->SP == ref->SP;
+}
+
+static void run_core(struct workspace *ws, struct chip8 *chip8, int count)
+{
+    switch (core)
+    {
+    case CORE_RUN:      /* Only partial frames come here, see advance. */
+    case CORE_STEP:
+        for (int i = 0; i < count; ++i)
+        {
+            chip8_step(chip8);
+        }
+        break;
+    case CORE_DEBUG:
+        chip8_debug_run(&ws->debugger, chip8, count);
+        break;
+    }
+}
+
+/* Runs both up to "count" more instructions. Keys change and timers tick
+on frame boundaries, every instructions_per_frame instructions. */
+static void advance(struct workspace *ws, const struct job *job,
+                    struct side *side, unsigned long long count)
+{
+    struct chip8 *chip8 = &side->chip8;
+    int ipf = chip8->instructions_per_frame;
+    while (count > 0 && !side->finished)
+    {
+        long frame = side->index / ipf;
+        int into_frame = side->index % ipf;
+        if (frame >= frames)
+        {
+            side->finished = true;
+            break;
+        }
+        if (into_frame == 0)
+        {
+            uint16_t keys = job_keys(job, frame);
+            chip8_keyboard_set_mask(&chip8->keyboard, keys);
+            for (int key = 0; key < CHIP8_TOTAL_KEYS; ++key)
+            {
+                side->ref.keys[key] = (keys >> key) & 1;
+            }
+        }
+
+        /* The model goes first, the interpreter must not run what the model
+        refused. */
+        int chunk = ipf - into_frame;
+        if ((unsigned long long)chunk > count)
+            chunk = count;
+        if (core == CORE_RUN && chunk == ipf)
+        {
+            int ran = 0;
+            while (ran < chunk)
+            {
+                side->stop = chip8_ref_step(&side->ref);
+                if (side->stop != CHIP8_REF_OK)
+                    break;
+                ran++;
+            }
+            chip8_run(chip8, ran);
+            side->index += ran;
+            count -= ran;
+            side->diverged = !registers_match(side);
+        }
+        else
+        {
+            for (int i = 0; i < chunk; ++i)
+            {
+                side->stop = chip8_ref_step(&side->ref);
+                if (side->stop != CHIP8_REF_OK)
+                    break;
+                run_core(ws, chip8, 1);
+                side->index++;
+                count--;
+                if (!registers_match(side))
+                {
+                    side->diverged = true;
+                    break;
+                }
+            }
+        }
+        if (side->stop != CHIP8_REF_OK || side->diverged)
+        {
+            side->finished = true;
+            break;
+        }
+
+        if (side->index % ipf == 0)
+        {
+            chip8_end_frame(chip8);
+            chip8_ref_tick(&side->ref);
+        }
+    }
+}
+
+static bool matches(struct workspace *ws, struct side *side)
+{
+    chip8_ref_from_chip8(&ws->converted, &side->chip8);
+    return chip8_ref_hash(&ws->converted) == chip8_ref_hash(&side->ref);
+}
+
+/* Prints every part of the state that differs, the interpreter first. */
+static void print_differences(const struct chip8_ref *a,
+                              const struct chip8_ref *b)
+{
+    printf("                interpreter  reference\n");
+    for (int i = 0; i < CHIP8_TOTAL_DATA_REGISTERS; ++i)
+    {
+        if (a->V[i] != b->V[i])
+            printf("    V%X          %02X           %02X\n", i, a->V[i],
+                   b->V[i]);
+    }
+    if (a->I != b->I)
+        printf("    I           %04X         %04X\n", a->I, b->I);
+    if (a->PC != b->PC)
+        printf("    PC          %04X         %04X\n", a->PC, b->PC);
+    if (a->SP != b->SP)
+        printf("    SP          %02X           %02X\n", a->SP, b->SP);
+    if (a->delay_timer != b->delay_timer)
+        printf("    DT          %02X           %02X\n", a->delay_timer,
+               b->delay_timer);
+    if (a->sound_timer != b->sound_timer)
+        printf("    ST          %02X           %02X\n", a->sound_timer,
+               b->sound_timer);
+    if (a->random != b->random)
+        printf("    random      %08X     %08X\n", a->random, b->random);
+    for (int i = 0; i < CHIP8_TOTAL_STACK_DEPTH; ++i)
+    {
+        if (a->stack[i] != b->stack[i])
+            printf("    stack[%d]   %04X         %04X\n", i, a->stack[i],
+                   b->stack[i]);
+    }
+
+    int listed = 0;
+    for (int i = 0; i < CHIP8_MEMORY_SIZE && listed < MAX_DUMPED_BYTES; ++i)
+    {
+        if (a->memory[i] != b->memory[i])
+        {
+            printf("    [%04X]      %02X           %02X\n", i, a->memory[i],
+                   b->memory[i]);
+            listed++;
+        }
+    }
+    for (int y = 0; y < CHIP8_HEIGHT; ++y)
+    {
+        if (memcmp(a->display[y], b->display[y], sizeof(a->display[y])) == 0)
+            continue;
+        printf("    row %-2d      ", y);
+        for (int x = 0; x < CHIP8_WIDTH; ++x)
+        {
+            putchar(a->display[y][x] ? '#' : '.');
+        }
+        printf("\n                ");
+        for (int x = 0; x < CHIP8_WIDTH; ++x)
+        {
+            putchar(b->display[y][x] ? '#' : '.');
+        }
+        printf("\n");
+    }
+}
+
+/* The states matched at "checkpoint" and not "count" instructions later.
+Finds the first instruction after which they differ and prints it. */
+static void bisect(struct workspace *ws, const struct job *job,
+                   unsigned long long count)
+{
+    unsigned long long low = 1;
+    unsigned long long high = count;
+    while (low < high)
+    {
+        unsigned long long mid = low + (high - low) / 2;
+        ws->probe = ws->checkpoint;
+        advance(ws, job, &ws->probe, mid);
+        if (matches(ws, &ws->probe))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    /* Run up to the faulty instruction, then through it. */
+    ws->probe = ws->checkpoint;
+    advance(ws, job, &ws->probe, low - 1);
+    unsigned short pc = ws->probe.ref.PC;
+    unsigned short opcode = ws->probe.ref.memory[pc] << 8 |
+                            ws->probe.ref.memory[pc + 1];
+    char mnemonic[CHIP8_DISASM_MAX_MNEMONIC + 1];
+    chip8_disasm_instruction(opcode, 0, mnemonic);
+    struct chip8_ref before = ws->probe.ref;
+    advance(ws, job, &ws->probe, 1);
+
+    /* Stepping through a frame chip8_run got wrong can go right, the 
+    frame is then shown as chip8_run left it. */
+    bool batched = matches(ws, &ws->probe);
+    if (batched)
+    {
+        ws->probe = ws->checkpoint;
+        advance(ws, job, &ws->probe, low);
+    }
+    chip8_ref_from_chip8(&ws->converted, &ws->probe.chip8);
+
+    pthread_mutex_lock(&output);
+    if (batched)
+    {
+        printf("%s: diverged in frame %llu run by chip8_run, stepping "
+               "through it doesn't\n", job->name,
+               (ws->probe.index - 1) / ws->probe.chip8.instructions_per_frame);
+    }
+    else
+    {
+        printf("%s: diverged at instruction %llu (frame %llu)\n", job->name,
+               ws->probe.index,
+               (ws->probe.index - 1) / 
+               ws->probe.chip8.instructions_per_frame);
+        printf("    %04X: %04X  %s\n", pc, opcode, mnemonic);
+        printf("  before:");
+        for (int i = 0; i < CHIP8_TOTAL_DATA_REGISTERS; ++i)
+        {
+            printf(" V%X=%02X", i, before.V[i]);
+        }
+        printf(" I=%04X SP=%02X\n", before.I, before.SP);
+    }
+    print_differences(&ws->converted, &ws->probe.ref);
+    pthread_mutex_unlock(&output);
+}
+
+static const char *stop_reason(enum chip8_ref_result stop)
+{
+    return stop == CHIP8_REF_UNSUPPORTED ? "unsupported instruction" :
+                                           "undefined behaviour";
+}
+
+static void run_job(struct workspace *ws, const struct job *job)
+{
+    struct chip8 *chip8 = &ws->current.chip8;
+    chip8_debug_init(&ws->debugger);
+    chip8_init(chip8);
+    chip8_seed(chip8, job->seed);
+
+    int res;
+    if (job->filename)
+    {
+        struct chip8_rom_file file;
+        struct chip8_rom rom;
+        res = chip8_rom_open(&file, job->filename, &rom);
+        if (res == CHIP8_ROM_OK)
+        {
+            res = chip8_load(chip8, (const char *)rom.data, rom.size);
+            chip8_rom_close(&file);
+        }
+    }
+    else
+    {
+        unsigned char program[RANDOM_PROGRAM_SIZE];
+        random_program(job->seed, program);
+        res = chip8_load(chip8, (const char *)program, sizeof(program));
+    }
+    if (res != CHIP8_ROM_OK)
+    {
+        pthread_mutex_lock(&output);
+        printf("%s: %s\n", job->name, chip8_rom_error_string(res));
+        pthread_mutex_unlock(&output);
+        return;
+    }
+
+    /* The model knows the default profile only. */
+    chip8->quirks = CHIP8_PROFILE_DEFAULT;
+    chip8_ref_from_chip8(&ws->current.ref, chip8);
+    ws->current.index = 0;
+    ws->current.stop = CHIP8_REF_OK;
+    ws->current.finished = false;
+    ws->current.diverged = false;
+    ws->checkpoint = ws->current;
+
+    while (!ws->current.finished)
+    {
+        unsigned long long start = ws->current.index;
+        advance(ws, job, &ws->current, interval);
+        if (!matches(ws, &ws->current))
+        {
+            bisect(ws, job, ws->current.index - start);
+            __atomic_fetch_add(&diverged, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        ws->checkpoint = ws->current;
+    }
+
+    pthread_mutex_lock(&output);
+    if (ws->current.stop == CHIP8_REF_OK)
+        printf("%s: ok, %llu instructions\n", job->name, ws->current.index);
+    else
+        printf("%s: ok, stopped after %llu instructions on %s, %04X at "
+               "%04X\n", job->name, ws->current.index, 
+               stop_reason(ws->current.stop), 
+               ws->current.ref.memory[ws->current.ref.PC] << 8 | 
+               ws->current.ref.memory[ws->current.ref.PC + 1], 
+               ws->current.ref.PC);
+    pthread_mutex_unlock(&output);
+}
+
+static void work(void *workspace, int index)
+{
+    run_job(workspace, &jobs[index]);
+}
+
+int main(int argc, char **argv)
+{
+    int random_programs = DEFAULT_RANDOM_PROGRAMS;
+    uint32_t seed = 1;
+    int threads = 4;
+    int roms = 0;
+    const char **filenames = calloc(argc, sizeof(char *));
+    if (!filenames)
+        return(-1);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--random") == 0 && i + 1 < argc)
+        {
+            random_programs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            interval = strtoull(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--core") == 0 && i + 1 < argc)
+        {
+            ++i;
+            if (strcmp(argv[i], "run") == 0)
+                core = CORE_RUN;
+            else if (strcmp(argv[i], "step") == 0)
+                core = CORE_STEP;
+            else if (strcmp(argv[i], "debug") == 0)
+                core = CORE_DEBUG;
+            else
+            {
+                fprintf(stderr, "Unknown core: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return(-1);
+        }
+        else
+        {
+            filenames[roms++] = argv[i];
+        }
+    }
+    if (frames <= 0 || interval == 0 || random_programs < 0 ||
+        threads < 1 || threads > CHIP8_POOL_MAX_THREADS)
+    {
+        fprintf(stderr, "Invalid arguments\n");
+        return(-1);
+    }
+
+    total_jobs = roms + random_programs;
+    jobs = calloc(total_jobs ? total_jobs : 1, sizeof(struct job));
+    if (!jobs)
+        return(-1);
+    for (int i = 0; i < roms; ++i)
+    {
+        snprintf(jobs[i].name, sizeof(jobs[i].name), "%s", filenames[i]);
+        jobs[i].filename = filenames[i];
+        jobs[i].seed = seed + i;
+    }
+    for (int i = 0; i < random_programs; ++i)
+    {
+        struct job *job = &jobs[roms + i];
+        job->seed = mix(seed) + i;
+        snprintf(job->name, sizeof(job->name), "random %08x", job->seed);
+    }
+
+    if (chip8_pool_run(threads, total_jobs, sizeof(struct workspace), 
+                       work) != 0)
+    {
+        fprintf(stderr, "Not every program could be run\n");
+        diverged++;
+    }
+
+    printf("%d of %d programs diverged\n", diverged, total_jobs);
+    free(jobs);
+    free(filenames);
+    return diverged ? 1 : 0;
+}
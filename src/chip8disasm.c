@@ -0,0 +1,122 @@
+#include "chip8disasm.h"
+#include "chip8opcodes.h"
+
+static const char chip8_disasm_hex[] = "0123456789ABCDEF";
+
+static char *chip8_disasm_put_hex(char *out, unsigned int val, int digits)
+{
+    for (int i = digits - 1; i >= 0; --i)
+    {
+        out[i] = chip8_disasm_hex[val & 0x0f];
+        val >>= 4;
+    }
+    return out + digits;
+}
+
+int chip8_disasm_instruction(unsigned short opcode, unsigned short next, 
+                             char *out)
+{
+    const char *format = chip8_opcodes[chip8_decode(opcode)].format;
+    char *p = out;
+
+    /* Plain characters are copied, placeholders are documented in
+    chip8opcodes.h. Numbers get a '#' prefix, register names do not. */
+    while (*format)
+    {
+        if (*format != '%')
+        {
+            *p++ = *format++;
+            continue;
+        }
+
+        format++;
+        if (format[0] == 'n' && format[1] == 'n' && format[2] == 'n' &&
+            format[3] == 'n')
+        {
+            *p++ = '#';
+            p = chip8_disasm_put_hex(p, next, 4);
+            format += 4;
+        }
+        else if (format[0] == 'o' && format[1] == 'o' && format[2] == 'o' &&
+                 format[3] == 'o')
+        {
+            *p++ = '#';
+            p = chip8_disasm_put_hex(p, opcode, 4);
+            format += 4;
+        }
+        else if (format[0] == 'n' && format[1] == 'n' && format[2] == 'n')
+        {
+            *p++ = '#';
+            p = chip8_disasm_put_hex(p, opcode & 0x0fff, 3);
+            format += 3;
+        }
+        else if (format[0] == 'k' && format[1] == 'k')
+        {
+            *p++ = '#';
+            p = chip8_disasm_put_hex(p, opcode & 0x00ff, 2);
+            format += 2;
+        }
+        else if (format[0] == 'n')
+        {
+            *p++ = '#';
+            p = chip8_disasm_put_hex(p, opcode & 0x000f, 1);
+            format++;
+        }
+        else if (format[0] == 'x')
+        {
+            p = chip8_disasm_put_hex(p, (opcode >> 8) & 0x000f, 1);
+            format++;
+        }
+        else if (format[0] == 'y')
+        {
+            p = chip8_disasm_put_hex(p, (opcode >> 4) & 0x000f, 1);
+            format++;
+        }
+        else
+        {
+            *p++ = '%';
+        }
+    }
+    *p = '\0';
+    return p - out;
+}
+
+size_t chip8_disasm(const unsigned char *code, size_t size,
+                    unsigned short address, char *out)
+{
+    chip8_opcodes_init();
+
+    char *p = out;
+    for (size_t i = 0; i < size; )
+    {
+        /* Missing trailing bytes are listed as zero. */
+        unsigned short opcode = code[i] << 8;
+        if (i + 1 < size)
+            opcode |= code[i + 1];
+
+        unsigned short next = 0;
+        int length = chip8_opcode_size(opcode);
+        if (length == 4)
+        {
+            next = (i + 2 < size ? code[i + 2] << 8 : 0) | 
+                   (i + 3 < size ? code[i + 3] : 0);
+        }
+
+        p = chip8_disasm_put_hex(p, address + i, 4);
+        *p++ = ':';
+        *p++ = ' ';
+        p = chip8_disasm_put_hex(p, opcode, 4);
+        *p++ = ' ';
+        if (length == 4)
+        {
+            p = chip8_disasm_put_hex(p, next, 4);
+            *p++ = ' ';
+        }
+        *p++ = ' ';
+        p += chip8_disasm_instruction(opcode, next, p);
+        *p++ = '\n';
+        i += length;
+    }
+    *p = '\0';
+    return p - out;
+}
@@ -0,0 +1,173 @@
+#include "chip8env.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHIP8_ENV_DEFAULT_FRAMESKIP 4
+
+#define CHIP8_ENV_EXPAND_1(i) \
+    { ((i) >> 7) & 1, ((i) >> 6) & 1, ((i) >> 5) & 1, ((i) >> 4) & 1, \
+      ((i) >> 3) & 1, ((i) >> 2) & 1, ((i) >> 1) & 1, (i) & 1 }
+#define CHIP8_ENV_EXPAND_4(i) \
+    CHIP8_ENV_EXPAND_1(i), CHIP8_ENV_EXPAND_1((i) + 1), \
+    CHIP8_ENV_EXPAND_1((i) + 2), CHIP8_ENV_EXPAND_1((i) + 3)
+#define CHIP8_ENV_EXPAND_16(i) \
+    CHIP8_ENV_EXPAND_4(i), CHIP8_ENV_EXPAND_4((i) + 4), \
+    CHIP8_ENV_EXPAND_4((i) + 8), CHIP8_ENV_EXPAND_4((i) + 12)
+#define CHIP8_ENV_EXPAND_64(i) \
+    CHIP8_ENV_EXPAND_16(i), CHIP8_ENV_EXPAND_16((i) + 16), \
+    CHIP8_ENV_EXPAND_16((i) + 32), CHIP8_ENV_EXPAND_16((i) + 48)
+
+/* The eight pixels of a byte, one per byte, the leftmost first. Built at 
+compile time, so environments on different threads never write it. */
+static const unsigned char chip8_env_expand[256][8] =
+{
+    CHIP8_ENV_EXPAND_64(0), CHIP8_ENV_EXPAND_64(64),
+    CHIP8_ENV_EXPAND_64(128), CHIP8_ENV_EXPAND_64(192)
+};
+
+/* Halves 64 pixels to 32, each set when either of its two pixels is. */
+static uint32_t chip8_env_halve(uint64_t pixels)
+{
+    uint64_t x = ((pixels | (pixels << 1)) >> 1) & 0x5555555555555555ULL;
+    x = (x | (x >> 1)) & 0x3333333333333333ULL;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+    x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+    return (uint32_t)x;
+}
+
+/* Returns the 64 pixels of row "y" of the observation in "plane". */
+static uint64_t chip8_env_row(const struct chip8_screen *screen, int plane,
+                              int y)
+{
+    if (!screen->hires)
+        return screen->rows[plane][y][0];
+
+    const uint64_t *top = screen->rows[plane][2 * y];
+    const uint64_t *bottom = screen->rows[plane][2 * y + 1];
+    return (uint64_t)chip8_env_halve(top[0] | bottom[0]) << 32 |
+           chip8_env_halve(top[1] | bottom[1]);
+}
+
+static void chip8_env_observe(struct chip8_env *env, int id, void *obs)
+{
+    const struct chip8_screen *screen = &env->instances[id].screen;
+    unsigned char *out = (unsigned char *)obs +
+                         id * chip8_env_observation_size(env);
+    for (int y = 0; y < CHIP8_HEIGHT; ++y)
+    {
+        uint64_t first = chip8_env_row(screen, 0, y);
+        if (env->observation == CHIP8_ENV_OBSERVE_BITS)
+        {
+            /* Any plane lights a pixel. */
+            uint64_t row = first | chip8_env_row(screen, 1, y);
+            for (int i = 0; i < 8; ++i)
+            {
+                *out++ = row >> (56 - 8 * i);
+            }
+            continue;
+        }
+
+        /* The second plane's pixels are 0 or 2, the sums never carry. */
+        uint64_t second = chip8_env_row(screen, 1, y);
+        for (int i = 0; i < 8; ++i)
+        {
+            uint64_t pixels, more;
+            memcpy(&pixels, chip8_env_expand[(first >> (56 - 8 * i)) & 0xff],
+                   8);
+            memcpy(&more, chip8_env_expand[(second >> (56 - 8 * i)) & 0xff],
+                   8);
+            pixels |= more << 1;
+            memcpy(out, &pixels, 8);
+            out += 8;
+        }
+    }
+}
+
+static void chip8_env_reset_one(struct chip8_env *env, int id)
+{
+    struct chip8 *chip8 = &env->instances[id];
+    memcpy(chip8, &env->initial, sizeof(struct chip8));
+    chip8_seed(chip8, env->seed + env->resets++);
+    env->frames[id] = 0;
+}
+
+int chip8_env_create(struct chip8_env *env, const char *buf, size_t size,
+                     int count)
+{
+    memset(env, 0, sizeof(struct chip8_env));
+    chip8_init(&env->initial);
+    int res = chip8_load(&env->initial, buf, size);
+    if (res != CHIP8_ROM_OK)
+        return res;
+
+    env->instances = malloc(count * sizeof(struct chip8));
+    env->frames = calloc(count, sizeof(unsigned int));
+    if (!env->instances || !env->frames)
+    {
+        chip8_env_destroy(env);
+        return CHIP8_ROM_ERROR_OPEN;
+    }
+    env->count = count;
+    env->frameskip = CHIP8_ENV_DEFAULT_FRAMESKIP;
+    env->observation = CHIP8_ENV_OBSERVE_BITS;
+    return CHIP8_ROM_OK;
+}
+
+size_t chip8_env_observation_size(const struct chip8_env *env)
+{
+    return env->observation == CHIP8_ENV_OBSERVE_BITS ?
+           CHIP8_ENV_BITS_SIZE : CHIP8_ENV_BYTES_SIZE;
+}
+
+void chip8_env_reset(struct chip8_env *env, const int *ids, int num,
+                     void *obs)
+{
+    if (!ids)
+        num = env->count;
+    for (int i = 0; i < num; ++i)
+    {
+        int id = ids ? ids[i] : i;
+        chip8_env_reset_one(env, id);
+        chip8_env_observe(env, id, obs);
+    }
+}
+
+void chip8_env_step(struct chip8_env *env, const uint16_t *actions,
+                    void *obs, float *reward, bool *done)
+{
+    for (int id = 0; id < env->count; ++id)
+    {
+        struct chip8 *chip8 = &env->instances[id];
+        chip8_keyboard_set_mask(&chip8->keyboard, actions[id]);
+
+        float total = 0;
+        bool end = false;
+        for (int frame = 0; frame < env->frameskip && !end; ++frame)
+        {
+            chip8_run_frame(chip8);
+            env->frames[id]++;
+            if (env->reward)
+                total += env->reward(chip8, id, &end, env->reward_data);
+            if (chip8->exited ||
+                (env->max_frames && env->frames[id] >= env->max_frames))
+                end = true;
+        }
+
+        reward[id] = total;
+        done[id] = end;
+        if (end)
+            chip8_env_reset_one(env, id);
+        chip8_env_observe(env, id, obs);
+    }
+}
+
+void chip8_env_destroy(struct chip8_env *env)
+{
+    free(env->instances);
+    free(env->frames);
+    env->instances = NULL;
+    env->frames = NULL;
+    env->count = 0;
+}
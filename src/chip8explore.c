@@ -0,0 +1,591 @@
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chip8.h"
+#include "chip8debug.h"
+#include "chip8hash.h"
+#include "chip8opcodes.h"
+#include "chip8rom.h"
+#include "chip8script.h"
+
+/*
+chip8-explore searches the states a ROM can reach by pressing keys, to test
+automatically that later levels can be reached:
+
+    chip8-explore ROM [--depth N] [--beam N] [--hold N] [--keys LIST]
+                  [--score vX|ADDR] [--goal N] [--memory N] [--table-bits N]
+                  [--threads N] [--output FILE]
+
+Each step holds one of the keys in LIST (hexadecimal digits, all 16 by
+default) or none for "hold" frames, branching every state of a level into
+its successors. States are told apart by a 64-bit hash kept in a hash set
+shared by all threads, so a state reached twice is explored once.
+
+Memory stays bounded by keeping at most "beam" states per level: with
+--score the best scoring, Vx or the byte at ADDR, making it a best-first
+beam search, otherwise the first by hash, a breadth-first search of a random
+sample. Successors are only hashed and scored at first, the ones kept are
+run again to take their snapshots. Snapshots hold the first --memory bytes
+of memory, 4KB unless the ROM needs more, and the search stops if a program
+writes past them, caught by a watchpoint.
+
+The search ends after "depth" steps or when the score reaches --goal. The
+keys leading to the best state are written to --output as an input script
+that chip8-headless and chip8-golden play back.
+*/
+
+#define DEFAULT_DEPTH 100
+#define DEFAULT_BEAM 4096
+#define DEFAULT_HOLD_FRAMES 4
+#define DEFAULT_TABLE_BITS 22
+#define MAX_THREADS 64
+
+/* Slots probed in the hash set before a state is explored regardless. */
+#define MAX_PROBES 32
+
+/* The first 4KB, all the original Chip-8 could address. */
+#define CLASSIC_MEMORY_SIZE 0x1000
+
+/* Where the part of struct chip8 after its memory starts. The rest of 
+struct chip8_memory, the executed and written maps and the code_written 
+hook, doesn't decide what the program does and is left out of snapshots, 
+but for the hash kept for memory. */
+#define TAIL_OFFSET (offsetof(struct chip8, memory) + \
+                     sizeof(struct chip8_memory))
+#define TAIL_SIZE (sizeof(struct chip8) - TAIL_OFFSET)
+#ifdef CHIP8_INCREMENTAL_HASH
+#define MEMORY_HASH_SIZE sizeof(uint64_t)
+#else
+#define MEMORY_HASH_SIZE 0
+#endif
+
+/* Actions are a key, or none. */
+#define ACTION_NONE CHIP8_TOTAL_KEYS
+#define MAX_ACTIONS (CHIP8_TOTAL_KEYS + 1)
+
+/* A successor, before deciding whether it is kept. */
+struct child
+{
+    uint64_t hash;
+    int score;
+    int parent;
+    unsigned char action;
+};
+
+/* One per thread. */
+struct workspace
+{
+    struct chip8 chip8;
+    struct chip8_debugger debugger;
+};
+
+/* How a kept state was reached, one per state of every level. */
+struct step
+{
+    int parent;
+    unsigned char action;
+};
+
+struct level
+{
+    struct step *steps;
+    int count;
+};
+
+static int max_depth = DEFAULT_DEPTH;
+static int beam = DEFAULT_BEAM;
+static int hold_frames = DEFAULT_HOLD_FRAMES;
+static int actions[MAX_ACTIONS];
+static int total_actions;
+static int score_register = -1;
+static long score_address = -1;
+static size_t extent;
+static size_t snapshot_size;
+
+/* The hash set, 0 marks a free slot. */
+static uint64_t *table;
+static uint64_t table_mask;
+static unsigned long long table_full;
+
+/* The states of the current level and the next one. */
+static unsigned char *states;
+static unsigned char *next_states;
+static int total_states;
+
+static struct child *children;
+static int total_children;
+static struct level *levels;
+
+/* Shared by the workers of one phase. */
+static void (*phase_work)(struct workspace *ws, int index);
+static int phase_items;
+static int next_item;
+static int threads = 4;
+static struct workspace *workspaces[MAX_THREADS];
+static int overflowed;
+
+static bool set_insert(uint64_t hash)
+{
+    if (hash == 0)
+        hash = 1;
+    uint64_t slot = hash & table_mask;
+    for (int i = 0; i < MAX_PROBES; ++i)
+    {
+        uint64_t *entry = &table[(slot + i) & table_mask];
+        uint64_t found = __atomic_load_n(entry, __ATOMIC_RELAXED);
+        if (found == 0)
+        {
+            uint64_t expected = 0;
+            if (__atomic_compare_exchange_n(entry, &expected, hash, false,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                return true;
+            found = expected;
+        }
+        if (found == hash)
+            return false;
+    }
+    __atomic_fetch_add(&table_full, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+/* Everything that decides what the program does next. The keys are set
+before every step and the instruction count differs between paths, so
+neither is part of it. Built with CHIP8_INCREMENTAL_HASH the interpreter
+keeps it up to date. */
+static uint64_t state_hash(const struct chip8 *chip8)
+{
+#ifdef CHIP8_INCREMENTAL_HASH
+    return chip8_state_hash(chip8);
+#else
+    const struct chip8_registers *registers = &chip8->registers;
+    unsigned short words[6] =
+    {
+        registers->I, registers->PC,
+        registers->SP | chip8_delay_timer(chip8) << 8,
+        chip8_sound_timer(chip8) | chip8->screen.hires << 8 |
+        chip8->screen.planes << 9 | chip8->exited << 11,
+        chip8->pitch, 0
+    };
+    uint64_t hash = chip8_hash(chip8->memory.memory, extent, 0);
+    hash = chip8_hash(chip8->screen.rows, sizeof(chip8->screen.rows), hash);
+    hash = chip8_hash(registers->V, sizeof(registers->V), hash);
+    hash = chip8_hash(chip8->stack.stack, sizeof(chip8->stack.stack), hash);
+    hash = chip8_hash(words, sizeof(words), hash);
+    hash = chip8_hash(chip8->rpl, sizeof(chip8->rpl), hash);
+    hash = chip8_hash(chip8->audio_pattern, sizeof(chip8->audio_pattern),
+                      hash);
+    return chip8_hash(&chip8->random, sizeof(chip8->random), hash);
+#endif
+}
+
+static int state_score(const struct chip8 *chip8)
+{
+    if (score_register >= 0)
+        return chip8->registers.V[score_register];
+    if (score_address >= 0)
+        return chip8->memory.memory[score_address];
+    return 0;
+}
+
+/* Snapshots are the memory up to "extent", its hash, then the rest of 
+struct chip8 after its memory. */
+static void save(const struct chip8 *chip8, unsigned char *snapshot)
+{
+    memcpy(snapshot, chip8->memory.memory, extent);
+#ifdef CHIP8_INCREMENTAL_HASH
+    memcpy(snapshot + extent, &chip8->memory.hash, MEMORY_HASH_SIZE);
+#endif
+    memcpy(snapshot + extent + MEMORY_HASH_SIZE, 
+           (const unsigned char *)chip8 + TAIL_OFFSET, TAIL_SIZE);
+}
+
+static void restore(struct chip8 *chip8, const unsigned char *snapshot)
+{
+    memcpy(chip8->memory.memory, snapshot, extent);
+#ifdef CHIP8_INCREMENTAL_HASH
+    memcpy(&chip8->memory.hash, snapshot + extent, MEMORY_HASH_SIZE);
+#endif
+    memcpy((unsigned char *)chip8 + TAIL_OFFSET, 
+           snapshot + extent + MEMORY_HASH_SIZE, TAIL_SIZE);
+}
+
+/* Memory past "extent" isn't saved, so it must stay clear. */
+static bool beyond_extent_clear(const struct chip8 *chip8)
+{
+    for (size_t i = extent; i < CHIP8_MEMORY_SIZE; ++i)
+    {
+        if (chip8->memory.memory[i])
+            return false;
+    }
+    return true;
+}
+
+/* Runs "action" from the state "parent" of the current level. Returns
+false when the program exited or was about to write past the snapshots. */
+static bool run_action(struct workspace *ws, int parent, int action)
+{
+    struct chip8 *chip8 = &ws->chip8;
+    restore(chip8, states + (size_t)parent * snapshot_size);
+    chip8_keyboard_set_mask(&chip8->keyboard, 
+                            action == ACTION_NONE ? 0 : 1 << action);
+    for (int frame = 0; frame < hold_frames && !chip8->exited; ++frame)
+    {
+        /* chip8_run_frame, stopping at the watchpoint. */
+        enum chip8_stop_reason reason = chip8_debug_run(&ws->debugger, chip8,
+                                        chip8->instructions_per_frame);
+        if (reason == CHIP8_STOP_WATCHPOINT)
+        {
+            __atomic_store_n(&overflowed, 1, __ATOMIC_RELAXED);
+            return false;
+        }
+        chip8_end_frame(chip8);
+    }
+    return !chip8->exited;
+}
+
+static void expand(struct workspace *ws, int parent)
+{
+    struct chip8 *chip8 = &ws->chip8;
+    for (int i = 0; i < total_actions; ++i)
+    {
+        if (!run_action(ws, parent, actions[i]))
+            continue;
+        uint64_t hash = state_hash(chip8);
+        if (!set_insert(hash))
+            continue;
+
+        int index = __atomic_fetch_add(&total_children, 1, __ATOMIC_RELAXED);
+        children[index].hash = hash;
+        children[index].score = state_score(chip8);
+        children[index].parent = parent;
+        children[index].action = actions[i];
+    }
+}
+
+static void materialise(struct workspace *ws, int index)
+{
+    run_action(ws, children[index].parent, children[index].action);
+    save(&ws->chip8, next_states + (size_t)index * snapshot_size);
+}
+
+/* Best score first, ties broken by hash to be the same on every run. */
+static int compare_children(const void *a, const void *b)
+{
+    const struct child *x = a;
+    const struct child *y = b;
+    if (x->score != y->score)
+        return y->score - x->score;
+    return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+static void *worker(void *arg)
+{
+    struct workspace *ws = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&next_item, 1, __ATOMIC_RELAXED)) <
+           phase_items)
+    {
+        phase_work(ws, i);
+    }
+    return NULL;
+}
+
+static void parallel(void (*work)(struct workspace *, int), int items)
+{
+    phase_work = work;
+    phase_items = items;
+    next_item = 0;
+    pthread_t ids[MAX_THREADS];
+    for (int i = 0; i < threads; ++i)
+    {
+        pthread_create(&ids[i], NULL, worker, workspaces[i]);
+    }
+    for (int i = 0; i < threads; ++i)
+    {
+        pthread_join(ids[i], NULL);
+    }
+}
+
+/* Writes the keys from the start to state "index" of level "depth". */
+static int write_path(const char *filename, int depth, int index)
+{
+    unsigned char *path = malloc(depth + 1);
+    if (!path)
+        return -1;
+    for (int d = depth; d > 0; --d)
+    {
+        path[d] = levels[d].steps[index].action;
+        index = levels[d].steps[index].parent;
+    }
+
+    struct chip8_script_writer writer;
+    if (chip8_script_create(&writer, filename) != 0)
+    {
+        free(path);
+        return -1;
+    }
+    for (int d = 1; d <= depth; ++d)
+    {
+        uint16_t keys = path[d] == ACTION_NONE ? 0 : 1 << path[d];
+        chip8_script_write(&writer, (unsigned long)(d - 1) * hold_frames,
+                           keys);
+    }
+    /* Let go at the end. */
+    chip8_script_write(&writer, (unsigned long)depth * hold_frames, 0);
+    free(path);
+    return chip8_script_close(&writer);
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int parse_keys(const char *list)
+{
+    total_actions = 0;
+    bool seen[CHIP8_TOTAL_KEYS] = {0};
+    for (const char *p = list; *p; ++p)
+    {
+        char digit[2] = { *p, '\0' };
+        char *end;
+        long key = strtol(digit, &end, 16);
+        if (*end != '\0' || seen[key])
+            return -1;
+        seen[key] = true;
+        actions[total_actions++] = key;
+    }
+    actions[total_actions++] = ACTION_NONE;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: chip8-explore ROM [--depth N] [--beam N] [--hold N]"
+               "\n       [--keys LIST] [--score vX|ADDR] [--goal N]"
+               "\n       [--memory N] [--table-bits N] [--threads N]"
+               "\n       [--output FILE]\n");
+        return(-1);
+    }
+
+    const char *filename = argv[1];
+    const char *output = NULL;
+    bool has_goal = false;
+    int goal = 0;
+    long memory = 0;
+    int table_bits = DEFAULT_TABLE_BITS;
+    parse_keys("0123456789abcdef");
+    for (int i = 2; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+        {
+            max_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--beam") == 0 && i + 1 < argc)
+        {
+            beam = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--hold") == 0 && i + 1 < argc)
+        {
+            hold_frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+        {
+            if (parse_keys(argv[++i]) != 0)
+            {
+                fprintf(stderr, "Invalid keys: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--score") == 0 && i + 1 < argc)
+        {
+            const char *what = argv[++i];
+            char *end;
+            if (what[0] == 'v' || what[0] == 'V')
+                score_register = strtol(what + 1, &end, 16);
+            else
+                score_address = strtol(what, &end, 0);
+            if (*end != '\0' || what[0] == '\0' ||
+                score_register >= CHIP8_TOTAL_DATA_REGISTERS ||
+                score_address >= CHIP8_MEMORY_SIZE)
+            {
+                fprintf(stderr, "Invalid score: %s\n", what);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--goal") == 0 && i + 1 < argc)
+        {
+            has_goal = true;
+            goal = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+        {
+            memory = strtol(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--table-bits") == 0 && i + 1 < argc)
+        {
+            table_bits = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return(-1);
+        }
+    }
+    if (max_depth < 1 || beam < 1 || hold_frames < 1 || threads < 1 ||
+        threads > MAX_THREADS || table_bits < 10 || table_bits > 32 ||
+        memory < 0 || memory > CHIP8_MEMORY_SIZE || memory % 8 != 0)
+    {
+        fprintf(stderr, "Invalid arguments\n");
+        return(-1);
+    }
+
+    struct chip8 *chip8 = malloc(sizeof(struct chip8));
+    if (!chip8)
+        return(-1);
+    chip8_init(chip8);
+    struct chip8_rom_file file;
+    struct chip8_rom rom;
+    int res = chip8_rom_open(&file, filename, &rom);
+    if (res == CHIP8_ROM_OK)
+    {
+        res = chip8_load(chip8, (const char *)rom.data, rom.size);
+        if (memory == 0)
+        {
+            memory = CHIP8_PROGRAM_LOAD_ADDRESS + rom.size <=
+                     CLASSIC_MEMORY_SIZE ? CLASSIC_MEMORY_SIZE :
+                                           CHIP8_MEMORY_SIZE;
+        }
+        chip8_rom_close(&file);
+    }
+    if (res != CHIP8_ROM_OK)
+    {
+        fprintf(stderr, "Failed to load %s: %s\n", filename,
+                chip8_rom_error_string(res));
+        return(-1);
+    }
+    extent = memory;
+    if (extent < CHIP8_MEMORY_SIZE && !beyond_extent_clear(chip8))
+    {
+        fprintf(stderr, "The ROM doesn't fit in %zu bytes\n", extent);
+        return(-1);
+    }
+
+    snapshot_size = extent + MEMORY_HASH_SIZE + TAIL_SIZE;
+    int max_children = beam * total_actions;
+    table = calloc((size_t)1 << table_bits, sizeof(uint64_t));
+    table_mask = ((uint64_t)1 << table_bits) - 1;
+    states = malloc((size_t)beam * snapshot_size);
+    next_states = malloc((size_t)beam * snapshot_size);
+    children = malloc((size_t)max_children * sizeof(struct child));
+    levels = calloc(max_depth + 1, sizeof(struct level));
+    if (!table || !states || !next_states || !children || !levels)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return(-1);
+    }
+    for (int i = 0; i < threads; ++i)
+    {
+        workspaces[i] = malloc(sizeof(struct workspace));
+        if (!workspaces[i])
+            return(-1);
+        workspaces[i]->chip8 = *chip8;
+        chip8_debug_init(&workspaces[i]->debugger);
+        if (extent < CHIP8_MEMORY_SIZE)
+            chip8_debug_add_watchpoint(&workspaces[i]->debugger, extent,
+                                       CHIP8_MEMORY_SIZE - 1);
+    }
+
+    save(chip8, states);
+    total_states = 1;
+    set_insert(state_hash(chip8));
+    int best_score = state_score(chip8);
+    int best_depth = 0;
+    int best_index = 0;
+    int reached = 0;
+    unsigned long long evaluated = 0;
+    unsigned long long unique = 1;
+    double start = seconds();
+
+    for (int depth = 1; depth <= max_depth && total_states > 0; ++depth)
+    {
+        total_children = 0;
+        parallel(expand, total_states);
+        evaluated += (unsigned long long)total_states * total_actions;
+        unique += total_children;
+        if (overflowed)
+        {
+            fprintf(stderr, "The program wrote past %zu bytes of memory, "
+                    "run again with a larger --memory\n", extent);
+            return(-1);
+        }
+
+        /* Keep the best "beam" children. */
+        qsort(children, total_children, sizeof(struct child),
+              compare_children);
+        int kept = total_children < beam ? total_children : beam;
+        parallel(materialise, kept);
+
+        levels[depth].count = kept;
+        levels[depth].steps = malloc((kept ? kept : 1) *
+                                     sizeof(struct step));
+        if (!levels[depth].steps)
+            return(-1);
+        for (int i = 0; i < kept; ++i)
+        {
+            levels[depth].steps[i].parent = children[i].parent;
+            levels[depth].steps[i].action = children[i].action;
+        }
+        unsigned char *swap = states;
+        states = next_states;
+        next_states = swap;
+        total_states = kept;
+        if (kept > 0)
+            reached = depth;
+
+        if (kept > 0 && children[0].score > best_score)
+        {
+            best_score = children[0].score;
+            best_depth = depth;
+            best_index = 0;
+        }
+        printf("depth %d: %d new states, %d kept, best score %d\n", depth,
+               total_children, kept, kept ? children[0].score : 0);
+        if (has_goal && best_score >= goal)
+            break;
+    }
+
+    double elapsed = seconds() - start;
+    printf("%llu states evaluated, %llu unique, in %.2fs (%.0f states/s)\n",
+           evaluated, unique, elapsed, elapsed > 0 ? evaluated / elapsed : 0);
+    if (table_full)
+        printf("%llu states found the hash set full, use a larger "
+               "--table-bits\n", table_full);
+
+    /* Without a score the last level reached is the furthest. */
+    if (score_register < 0 && score_address < 0)
+        best_depth = reached;
+    printf("best score %d at depth %d\n", best_score, best_depth);
+    if (output && write_path(output, best_depth, best_index) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", output);
+        return(-1);
+    }
+    return has_goal && best_score < goal ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "chip8.h"
+
+/*
+libFuzzer target for the interpreter, built by "make fuzz" with clang,
+AddressSanitizer and UndefinedBehaviorSanitizer:
+
+    ./bin/chip8-fuzz -max_len=4096 corpus
+
+An input is a small header, an input script and the ROM:
+
+    uint8 quirks  uint8 frames  uint16 keys[frames]  ROM
+
+The ROM runs for "frames" frames, at most FUZZ_MAX_FRAMES, holding
+keys[f] down during frame f. Assertion failures are findings like any
+sanitizer report, so stack overflows or accesses past the end of memory
+through I show up as crashes. Run with -fork=N -ignore_crashes=1 to keep
+going after those.
+
+Each run starts from a copy of a chip8 initialised once rather than from
+chip8_init. Besides the code coverage clang adds, every address executed
+counts as a feature, so inputs reaching new parts of the ROM are kept.
+*/
+
+#define FUZZ_MAX_FRAMES 64
+#define FUZZ_HEADER_SIZE 2
+
+#ifdef __linux__
+__attribute__((used, section("__libfuzzer_extra_counters")))
+#endif
+static uint8_t fuzz_pc_counters[CHIP8_MEMORY_SIZE / 2];
+
+static struct chip8 fuzz_template;
+static struct chip8 fuzz_chip8;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+    chip8_init(&fuzz_template);
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < FUZZ_HEADER_SIZE)
+        return 0;
+
+    int frames = data[1] < FUZZ_MAX_FRAMES ? data[1] : FUZZ_MAX_FRAMES;
+    size_t script_size = FUZZ_HEADER_SIZE + 2 * (size_t)frames;
+    if (size <= script_size)
+        return 0;
+
+    struct chip8 *chip8 = &fuzz_chip8;
+    memcpy(chip8, &fuzz_template, sizeof(struct chip8));
+    if (chip8_load(chip8, (const char *)data + script_size,
+                   size - script_size) != CHIP8_ROM_OK)
+        return 0;
+    chip8->quirks = data[0] % CHIP8_TOTAL_QUIRK_PROFILES;
+
+    const uint8_t *script = data + FUZZ_HEADER_SIZE;
+    for (int frame = 0; frame < frames && !chip8->exited; ++frame)
+    {
+        chip8_keyboard_set_mask(&chip8->keyboard, 
+                                script[2 * frame] | script[2 * frame + 1] << 8);
+
+        for (int i = 0; i < chip8->instructions_per_frame; ++i)
+        {
+            uint8_t *counter = &fuzz_pc_counters[chip8->registers.PC / 2];
+            if (*counter < UINT8_MAX)
+                (*counter)++;
+            chip8_step(chip8);
+            if (chip8->exited)
+                break;
+        }
+
+        chip8_end_frame(chip8);
+    }
+    return 0;
+}
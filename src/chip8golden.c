@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8hash.h"
+#include "chip8pool.h"
+#include "chip8rom.h"
+#include "chip8script.h"
+
+/*
+chip8-golden plays ROMs with recorded input and compares the screen at every
+frame against golden hashes, so a change to what the interpreter draws is
+caught without anyone watching:
+
+    chip8-golden [--golden DIR] [--update] [--frames N] [--threads N] ROM...
+
+For a ROM named NAME, DIR (./golden by default) holds NAME.golden, the hash
+of struct chip8_screen after each frame, one per line, and optionally
+NAME.keys, the input script of chip8script.h recorded with main's
+--record-keys. Without a script no key is ever pressed. The ROMs run on as
+many threads, and the first frame that differs from the golden hashes is
+reported.
+
+--update writes NAME.golden from the current interpreter instead, N frames
+long (1800, half a minute, by default). Only do so when a change of the
+output is intended. The exit status is 1 when any ROM differed or couldn't
+be checked.
+*/
+
+#define DEFAULT_GOLDEN_DIR "./golden"
+#define DEFAULT_FRAMES 1800
+#define MAX_PATH_SIZE 512
+
+enum result
+{
+    RESULT_OK,
+    RESULT_UPDATED,
+    RESULT_DIFFERS,
+    RESULT_ERROR
+};
+
+struct job
+{
+    const char *filename;
+    char name[64];
+
+    enum result result;
+    long frames;
+    long first_difference;
+    uint64_t expected;
+    uint64_t actual;
+    char error[MAX_PATH_SIZE + 64];
+};
+
+static const char *golden_dir = DEFAULT_GOLDEN_DIR;
+static bool update;
+static long update_frames = DEFAULT_FRAMES;
+
+static struct job *jobs;
+static int total_jobs;
+
+static uint64_t screen_hash(const struct chip8_screen *screen)
+{
+    unsigned char mode[2] = { screen->hires, screen->planes };
+    uint64_t hash = chip8_hash(mode, sizeof(mode), 0);
+    return chip8_hash(screen->rows, sizeof(screen->rows), hash);
+}
+
+/* Reads the golden hashes, returning how many or -1 on error. */
+static long load_golden(const char *filename, uint64_t **hashes)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file)
+        return -1;
+
+    long count = 0;
+    long capacity = 0;
+    *hashes = NULL;
+    char line[128];
+    while (fgets(line, sizeof(line), file))
+    {
+        unsigned long long hash;
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%llx", &hash) != 1)
+        {
+            count = -1;
+            break;
+        }
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            uint64_t *grown = realloc(*hashes, capacity * sizeof(uint64_t));
+            if (!grown)
+            {
+                count = -1;
+                break;
+            }
+            *hashes = grown;
+        }
+        (*hashes)[count++] = hash;
+    }
+    fclose(file);
+
+    if (count < 0)
+    {
+        free(*hashes);
+        *hashes = NULL;
+    }
+    return count;
+}
+
+static int save_golden(const char *filename, const struct job *job,
+                       const uint64_t *hashes, long count)
+{
+    FILE *file = fopen(filename, "w");
+    if (!file)
+        return -1;
+    fprintf(file, "# chip8-golden %s, %ld frames\n", job->name, count);
+    for (long i = 0; i < count; ++i)
+    {
+        fprintf(file, "%016llx\n", (unsigned long long)hashes[i]);
+    }
+    return (ferror(file) | fclose(file)) ? -1 : 0;
+}
+
+static void fail(struct job *job, const char *message, const char *filename)
+{
+    job->result = RESULT_ERROR;
+    snprintf(job->error, sizeof(job->error), "%s %s", message, filename);
+}
+
+static void run_job(struct chip8 *chip8, struct job *job)
+{
+    char path[MAX_PATH_SIZE];
+    struct chip8_script script;
+    snprintf(path, sizeof(path), "%s/%s.keys", golden_dir, job->name);
+    if (chip8_script_load(&script, path) != 0)
+    {
+        /* A missing script means no input, a broken one is an error. */
+        FILE *file = fopen(path, "r");
+        if (file)
+        {
+            fclose(file);
+            fail(job, "Invalid input script", path);
+            return;
+        }
+    }
+
+    uint64_t *golden = NULL;
+    snprintf(path, sizeof(path), "%s/%s.golden", golden_dir, job->name);
+    if (update)
+    {
+        job->frames = update_frames;
+        golden = malloc(job->frames * sizeof(uint64_t));
+        if (!golden)
+        {
+            fail(job, "Out of memory for", path);
+            chip8_script_free(&script);
+            return;
+        }
+    }
+    else
+    {
+        job->frames = load_golden(path, &golden);
+        if (job->frames < 0)
+        {
+            fail(job, "Couldn't read", path);
+            chip8_script_free(&script);
+            return;
+        }
+    }
+
+    chip8_init(chip8);
+    struct chip8_rom_file file;
+    struct chip8_rom rom;
+    int res = chip8_rom_open(&file, job->filename, &rom);
+    if (res == CHIP8_ROM_OK)
+    {
+        res = chip8_load(chip8, (const char *)rom.data, rom.size);
+        chip8_rom_close(&file);
+    }
+    if (res != CHIP8_ROM_OK)
+    {
+        fail(job, chip8_rom_error_string(res), job->filename);
+        chip8_script_free(&script);
+        free(golden);
+        return;
+    }
+
+    job->result = update ? RESULT_UPDATED : RESULT_OK;
+    bool exited = false;
+    for (long frame = 0; frame < job->frames; ++frame)
+    {
+        chip8_keyboard_set_mask(&chip8->keyboard, 
+                                chip8_script_keys(&script, frame));
+
+        /* After 00FD the screen stays as it was. */
+        if (!exited)
+            exited = chip8_run_frame(chip8) == CHIP8_STOP_EXIT;
+
+        uint64_t hash = screen_hash(&chip8->screen);
+        if (update)
+        {
+            golden[frame] = hash;
+        }
+        else if (hash != golden[frame])
+        {
+            job->result = RESULT_DIFFERS;
+            job->first_difference = frame;
+            job->expected = golden[frame];
+            job->actual = hash;
+            break;
+        }
+    }
+
+    if (update && save_golden(path, job, golden, job->frames) != 0)
+        fail(job, "Couldn't write", path);
+    chip8_script_free(&script);
+    free(golden);
+}
+
+static void work(void *workspace, int index)
+{
+    run_job(workspace, &jobs[index]);
+}
+
+/* The file name without directories or extension. */
+static void rom_name(const char *filename, char *name, size_t size)
+{
+    const char *base = filename;
+    for (const char *p = filename; *p; ++p)
+    {
+        if (*p == '/' || *p == '\\')
+            base = p + 1;
+    }
+    size_t length = strcspn(base, ".");
+    if (length >= size)
+        length = size - 1;
+    memcpy(name, base, length);
+    name[length] = '\0';
+}
+
+int main(int argc, char **argv)
+{
+    int threads = 4;
+    jobs = calloc(argc, sizeof(struct job));
+    if (!jobs)
+        return(-1);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+        {
+            golden_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--update") == 0)
+        {
+            update = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            update_frames = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+        }
+        else if (argv[i][0] == '-')
+        {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return(-1);
+        }
+        else
+        {
+            struct job *job = &jobs[total_jobs++];
+            job->filename = argv[i];
+            rom_name(argv[i], job->name, sizeof(job->name));
+            job->result = RESULT_ERROR;
+            snprintf(job->error, sizeof(job->error), "Not run");
+        }
+    }
+    if (total_jobs == 0 || update_frames <= 0 || threads < 1 ||
+        threads > CHIP8_POOL_MAX_THREADS)
+    {
+        fprintf(stderr, "Usage: chip8-golden [--golden DIR] [--update] "
+                "[--frames N] [--threads N] ROM...\n");
+        return(-1);
+    }
+
+    /* Jobs that never ran are still marked "Not run". */
+    chip8_pool_run(threads, total_jobs, sizeof(struct chip8), work);
+
+    int failed = 0;
+    for (int i = 0; i < total_jobs; ++i)
+    {
+        struct job *job = &jobs[i];
+        switch (job->result)
+        {
+        case RESULT_OK:
+            printf("%s: ok, %ld frames\n", job->name, job->frames);
+            break;
+        case RESULT_UPDATED:
+            printf("%s: updated, %ld frames\n", job->name, job->frames);
+            break;
+        case RESULT_DIFFERS:
+            printf("%s: differs at frame %ld, expected %016llx, got "
+                   "%016llx\n", job->name, job->first_difference,
+                   (unsigned long long)job->expected,
+                   (unsigned long long)job->actual);
+            failed++;
+            break;
+        case RESULT_ERROR:
+            printf("%s: %s\n", job->name, job->error);
+            failed++;
+            break;
+        }
+    }
+    printf("%d of %d ROMs failed\n", failed, total_jobs);
+    free(jobs);
+    return failed ? 1 : 0;
+}
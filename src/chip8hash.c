@@ -0,0 +1,102 @@
+#include "chip8hash.h"
+#include <string.h>
+
+/* XXH64, as specified at https://github.com/Cyan4973/xxHash. Input is read 
+little-endian whatever the host. */
+
+#define CHIP8_HASH_PRIME1 0x9e3779b185ebca87ULL
+#define CHIP8_HASH_PRIME2 0xc2b2ae3d27d4eb4fULL
+#define CHIP8_HASH_PRIME3 0x165667b19e3779f9ULL
+#define CHIP8_HASH_PRIME4 0x85ebca77c2b2ae63ULL
+#define CHIP8_HASH_PRIME5 0x27d4eb2f165667c5ULL
+
+static uint64_t chip8_hash_rotl(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t chip8_hash_read64(const unsigned char *p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+static uint32_t chip8_hash_read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | 
+           (uint32_t)p[3] << 24;
+}
+
+static uint64_t chip8_hash_round(uint64_t acc, uint64_t input)
+{
+    acc += input * CHIP8_HASH_PRIME2;
+    acc = chip8_hash_rotl(acc, 31);
+    return acc * CHIP8_HASH_PRIME1;
+}
+
+static uint64_t chip8_hash_merge(uint64_t acc, uint64_t value)
+{
+    acc ^= chip8_hash_round(0, value);
+    return acc * CHIP8_HASH_PRIME1 + CHIP8_HASH_PRIME4;
+}
+
+uint64_t chip8_hash(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *p = data;
+    const unsigned char *end = p + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + CHIP8_HASH_PRIME1 + CHIP8_HASH_PRIME2;
+        uint64_t v2 = seed + CHIP8_HASH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - CHIP8_HASH_PRIME1;
+        for (; end - p >= 32; p += 32)
+        {
+            v1 = chip8_hash_round(v1, chip8_hash_read64(p));
+            v2 = chip8_hash_round(v2, chip8_hash_read64(p + 8));
+            v3 = chip8_hash_round(v3, chip8_hash_read64(p + 16));
+            v4 = chip8_hash_round(v4, chip8_hash_read64(p + 24));
+        }
+        hash = chip8_hash_rotl(v1, 1) + chip8_hash_rotl(v2, 7) + 
+               chip8_hash_rotl(v3, 12) + chip8_hash_rotl(v4, 18);
+        hash = chip8_hash_merge(hash, v1);
+        hash = chip8_hash_merge(hash, v2);
+        hash = chip8_hash_merge(hash, v3);
+        hash = chip8_hash_merge(hash, v4);
+    }
+    else
+    {
+        hash = seed + CHIP8_HASH_PRIME5;
+    }
+    hash += size;
+
+    for (; end - p >= 8; p += 8)
+    {
+        hash ^= chip8_hash_round(0, chip8_hash_read64(p));
+        hash = chip8_hash_rotl(hash, 27) * CHIP8_HASH_PRIME1 + 
+               CHIP8_HASH_PRIME4;
+    }
+    if (end - p >= 4)
+    {
+        hash ^= chip8_hash_read32(p) * CHIP8_HASH_PRIME1;
+        hash = chip8_hash_rotl(hash, 23) * CHIP8_HASH_PRIME2 + 
+               CHIP8_HASH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        hash ^= *p * CHIP8_HASH_PRIME5;
+        hash = chip8_hash_rotl(hash, 11) * CHIP8_HASH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= CHIP8_HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= CHIP8_HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
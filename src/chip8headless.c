@@ -0,0 +1,668 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chip8.h"
+#include "chip8hash.h"
+#include "chip8netplay.h"
+#include "chip8phosphor.h"
+#include "chip8profile.h"
+#include "chip8rom.h"
+#include "chip8romdb.h"
+#include "chip8scale.h"
+#include "chip8script.h"
+#include "chip8shm.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#define write _write
+#define open _open
+#define close _close
+#define OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC | O_BINARY)
+
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+#else
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC)
+
+/* Only declared for X/Open, Linux, macOS and the BSDs all allow 1024. */
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
+/*
+chip8-headless runs a ROM without a window or sound and streams every frame
+as Y4M or raw 8-bit greyscale, so it can be piped into encoders and analysis
+tools:
+
+    chip8-headless ROM --frames 3600 --scale 4 | ffmpeg -i - out.mp4
+    chip8-headless ROM --format raw | ffmpeg -f rawvideo -pix_fmt gray
+                                             -s 128x64 -r 60 -i - out.mp4
+
+Frames are CHIP8_HIRES_WIDTH x CHIP8_HIRES_HEIGHT times the scale, low
+resolution pixels count double. --filter scale2x or scale3x smooths them
+first, see chip8scale.h, and makes them twice or three times as large.
+--phosphor PERCENT fades pixels out over frames, see chip8phosphor.h.
+
+With --netplay it plays against another instance, the keys coming from a
+bot with --bot. Two bots on one machine test netplay over loopback, both
+must print the same state at the end:
+
+    chip8-headless PONG --format none --netplay 7001:localhost:7002 --bot 1
+    chip8-headless PONG --format none --netplay 7002:localhost:7001 --bot 2
+
+Without netplay the keys come from the bot or from an input script played
+with --keys, see chip8script.h, and --record-keys writes the keys held to
+one, so a bot's game can become one of chip8-golden's.
+
+--profile FILE writes the instructions run by each call path as collapsed 
+stacks, see chip8profile.h, and prints the busiest subroutines:
+
+    chip8-headless BRIX --format none --bot 1 --profile brix.folded
+    flamegraph.pl brix.folded > brix.svg
+
+Programs that write to code they already executed are reported at the end, 
+see chip8memory.h.
+*/
+
+#define DEFAULT_FRAMES 600
+#define MAX_SCALE 16
+
+/* Subroutines listed after profiling. */
+#define PROFILE_SUMMARY_SIZE 10
+
+/* Bots hold their keys this many frames. */
+#define BOT_HOLD_FRAMES 10
+
+/* Netplay gives up on a silent peer after this long. */
+#define NETPLAY_TIMEOUT_MS 5000
+
+enum video_format
+{
+    VIDEO_Y4M,
+    VIDEO_RAW,
+    VIDEO_NONE
+};
+
+/* Grey levels of the four plane combinations, like the window's palette. */
+static const unsigned char grey[1 << CHIP8_TOTAL_PLANES] = {0, 255, 170, 85};
+
+static const char y4m_frame_header[] = "FRAME\n";
+
+struct video
+{
+    int fd;
+    enum video_format format;
+    enum chip8_scale_filter filter;
+    int scale;
+    int width;
+    int height;
+
+    /* The colours out of the filter, then their grey levels. */
+    unsigned char *image;
+    int image_width;
+    int image_height;
+
+    bool fading;
+    struct chip8_phosphor phosphor;
+
+    /* One scaled row per image row. Each is written "scale" times, the
+    vertical scaling is done by the iovecs. */
+    unsigned char *rows;
+
+    /* Y4M chroma plane, the same neutral grey for U and V. */
+    unsigned char *chroma;
+    size_t chroma_size;
+
+    struct iovec *iov;
+};
+
+#ifdef _WIN32
+static int write_iov(int fd, struct iovec *iov, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const char *data = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+        while (left > 0)
+        {
+            int n = write(fd, data, left);
+            if (n < 0)
+                return -1;
+            data += n;
+            left -= n;
+        }
+    }
+    return 0;
+}
+#else
+/* Writes all of the iovecs, IOV_MAX at a time, resuming partial writes. */
+static int write_iov(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+#endif
+
+static int video_open(struct video *video, const char *filename,
+                      enum video_format format,
+                      enum chip8_scale_filter filter, int scale,
+                      int persistence)
+{
+    memset(video, 0, sizeof(struct video));
+    video->format = format;
+    video->filter = filter;
+    video->scale = scale;
+    video->image_width = CHIP8_HIRES_WIDTH * chip8_scale_factor(filter);
+    video->image_height = CHIP8_HIRES_HEIGHT * chip8_scale_factor(filter);
+    video->width = video->image_width * scale;
+    video->height = video->image_height * scale;
+    if (format == VIDEO_NONE)
+        return 0;
+
+    if (strcmp(filename, "-") == 0)
+    {
+#ifdef _WIN32
+        _setmode(1, _O_BINARY);
+#endif
+        video->fd = 1;
+    }
+    else
+    {
+        /* Also works for named pipes, which is why this isn't fopen. */
+        video->fd = open(filename, OPEN_FLAGS, 0644);
+        if (video->fd < 0)
+            return -1;
+    }
+
+    video->image = malloc((size_t)video->image_width * video->image_height);
+    video->rows = malloc((size_t)video->image_height * video->width);
+    video->chroma_size = (size_t)(video->width / 2) * (video->height / 2);
+    video->chroma = malloc(video->chroma_size);
+    video->iov = malloc((video->height + 3) * sizeof(struct iovec));
+    if (!video->image || !video->rows || !video->chroma || !video->iov)
+        return -1;
+    if (persistence >= 0)
+    {
+        video->fading = true;
+        if (chip8_phosphor_init(&video->phosphor, (size_t)video->image_width *
+                                video->image_height, persistence) != 0)
+            return -1;
+    }
+    memset(video->chroma, 128, video->chroma_size);
+
+    if (format == VIDEO_Y4M)
+    {
+        char header[80];
+        int size = sprintf(header, 
+                           "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                           video->width, video->height, 
+                           CHIP8_FRAMES_PER_SECOND);
+        struct iovec iov = { header, size };
+        if (write_iov(video->fd, &iov, 1) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int video_write(struct video *video, struct chip8_screen *screen)
+{
+    if (video->format == VIDEO_NONE)
+        return 0;
+
+    int scale = video->scale;
+    int size = video->image_width * video->image_height;
+    chip8_scale_render(video->filter, screen, video->image);
+    for (int i = 0; i < size; ++i)
+    {
+        video->image[i] = grey[video->image[i]];
+    }
+    if (video->fading)
+        chip8_phosphor_blend(&video->phosphor, video->image);
+
+    const unsigned char *levels = video->image;
+    for (int y = 0; y < video->image_height; ++y)
+    {
+        unsigned char *row = video->rows + (size_t)y * video->width;
+        for (int x = 0; x < video->image_width; ++x)
+        {
+            memset(row + x * scale, *levels++, scale);
+        }
+    }
+
+    /* The iovecs are consumed by partial writes, so rebuild them. */
+    struct iovec *iov = video->iov;
+    int count = 0;
+    if (video->format == VIDEO_Y4M)
+    {
+        iov[count].iov_base = (void *)y4m_frame_header;
+        iov[count++].iov_len = sizeof(y4m_frame_header) - 1;
+    }
+    for (int y = 0; y < video->height; ++y)
+    {
+        iov[count].iov_base = video->rows + 
+                              (size_t)(y / scale) * video->width;
+        iov[count++].iov_len = video->width;
+    }
+    if (video->format == VIDEO_Y4M)
+    {
+        for (int plane = 0; plane < 2; ++plane)
+        {
+            iov[count].iov_base = video->chroma;
+            iov[count++].iov_len = video->chroma_size;
+        }
+    }
+    return write_iov(video->fd, iov, count);
+}
+
+static void video_close(struct video *video)
+{
+    if (video->format != VIDEO_NONE && video->fd > 1)
+        close(video->fd);
+    chip8_phosphor_free(&video->phosphor);
+    free(video->image);
+    free(video->rows);
+    free(video->chroma);
+    free(video->iov);
+}
+
+static void sleep_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+/* The keys a bot holds on "frame", a few at a time. */
+static uint16_t bot_keys(uint32_t seed, long frame)
+{
+    uint32_t x = seed * 0x9e3779b9 + (frame / BOT_HOLD_FRAMES) * 0x85ebca6b;
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x & (x >> 16);
+}
+
+/* Identifies the machine state, to compare runs. */
+static uint64_t state_hash(struct chip8 *chip8)
+{
+    unsigned short pointers[2] = { chip8->registers.PC, chip8->registers.I };
+    uint64_t hash = chip8_hash(chip8->memory.memory, 
+                               sizeof(chip8->memory.memory), 0);
+    hash = chip8_hash(chip8->screen.rows, sizeof(chip8->screen.rows), hash);
+    hash = chip8_hash(chip8->registers.V, sizeof(chip8->registers.V), hash);
+    return chip8_hash(pointers, sizeof(pointers), hash);
+}
+
+static void print_netplay_stats(const struct chip8_netplay_stats *stats)
+{
+    fprintf(stderr, "netplay: %llu frames, %llu rollbacks resimulating %llu "
+            "frames in %.2fms, deepest %d, %llu stalls\n", stats->frames, 
+            stats->rollbacks, stats->resimulated_frames, 
+            stats->total_resim_ms, stats->max_rollback_depth, stats->stalls);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: chip8-headless ROM [--frames N] [--format y4m|raw|none]"
+               "\n       [--scale N] [--filter none|scale2x|scale3x]"
+               "\n       [--phosphor PERCENT] [--output FILE]"
+               "\n       [--quirks PROFILE]"
+               "\n       [--romdb FILE] [--archive FILE] [--seed N]"
+               "\n       [--netplay LOCALPORT:HOST:PORT] [--bot SEED]"
+               "\n       [--netstats] [--shm NAME] [--keys FILE]"
+               "\n       [--record-keys FILE] [--profile FILE]\n");
+        return(-1);
+    }
+
+    const char *filename = argv[1];
+    const char *output = "-";
+    const char *archive_filename = NULL;
+    long frames = DEFAULT_FRAMES;
+    enum video_format format = VIDEO_Y4M;
+    int scale = 1;
+    int filter = CHIP8_SCALE_NONE;
+    int persistence = -1;
+    int quirks = -1;
+    uint32_t seed = 0;
+    const char *netplay_arg = NULL;
+    bool bot = false;
+    uint32_t bot_seed = 0;
+    bool netstats = false;
+    const char *shm_name = NULL;
+    const char *keys_filename = NULL;
+    const char *record_keys_filename = NULL;
+    const char *profile_filename = NULL;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            frames = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "y4m") == 0)
+                format = VIDEO_Y4M;
+            else if (strcmp(name, "raw") == 0)
+                format = VIDEO_RAW;
+            else if (strcmp(name, "none") == 0)
+                format = VIDEO_NONE;
+            else
+            {
+                fprintf(stderr, "Unknown format: %s\n", name);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+        {
+            scale = atoi(argv[++i]);
+            if (scale < 1 || scale > MAX_SCALE)
+            {
+                fprintf(stderr, "The scale must be 1 to %d\n", MAX_SCALE);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = chip8_scale_parse(argv[++i]);
+            if (filter < 0)
+            {
+                fprintf(stderr, "Unknown filter: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--phosphor") == 0 && i + 1 < argc)
+        {
+            persistence = atoi(argv[++i]);
+            if (persistence < 0 || persistence > 99)
+            {
+                fprintf(stderr, "The persistence must be 0 to 99\n");
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            quirks = chip8_quirks_parse(argv[++i]);
+            if (quirks < 0)
+            {
+                fprintf(stderr, "Unknown quirk profile: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--romdb") == 0 && i + 1 < argc)
+        {
+            if (chip8_romdb_load_overrides(argv[++i]) != 0)
+            {
+                fprintf(stderr, "Invalid ROM database: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+        {
+            archive_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--netplay") == 0 && i + 1 < argc)
+        {
+            netplay_arg = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc)
+        {
+            bot = true;
+            bot_seed = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--netstats") == 0)
+        {
+            netstats = true;
+        }
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+        {
+            shm_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--keys") == 0 && i + 1 < argc)
+        {
+            keys_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record-keys") == 0 && i + 1 < argc)
+        {
+            record_keys_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_filename = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            return(-1);
+        }
+    }
+
+    struct chip8_rom_file rom_file = {0};
+    struct chip8_rom_archive archive = {0};
+    struct chip8_rom rom;
+    int res;
+    if (archive_filename)
+    {
+        res = chip8_rom_archive_open(&archive, archive_filename);
+        if (res == CHIP8_ROM_OK)
+            res = chip8_rom_archive_find(&archive, filename, &rom);
+    }
+    else
+    {
+        res = chip8_rom_open(&rom_file, filename, &rom);
+    }
+
+    /* Far too large for the stack with XO-CHIP's 64KB of memory. */
+    static struct chip8 chip8;
+    chip8_init(&chip8);
+    if (res == CHIP8_ROM_OK)
+        res = chip8_load(&chip8, (const char *)rom.data, rom.size);
+    chip8_rom_archive_close(&archive);
+    chip8_rom_close(&rom_file);
+    if (res != CHIP8_ROM_OK)
+    {
+        fprintf(stderr, "Failed to load %s: %s\n", filename,
+                chip8_rom_error_string(res));
+        return(-1);
+    }
+    if (quirks >= 0)
+        chip8.quirks = quirks;
+    chip8_seed(&chip8, seed);
+
+    /* Holds the snapshots, keep it off the stack. */
+    static struct chip8_netplay netplay;
+    if (netplay_arg)
+    {
+        char host[256];
+        int local_port, peer_port;
+        if (chip8_netplay_parse(netplay_arg, &local_port, host, sizeof(host), 
+                                &peer_port) != 0 ||
+            chip8_netplay_open(&netplay, &chip8, local_port, host, 
+                               peer_port) != 0)
+        {
+            fprintf(stderr, "Failed to start netplay: %s\n", netplay_arg);
+            return(-1);
+        }
+    }
+
+    struct chip8_shm shm = {0};
+    if (shm_name && chip8_shm_create(&shm, shm_name) != 0)
+    {
+        fprintf(stderr, "Failed to create shared memory: %s\n", shm_name);
+        return(-1);
+    }
+
+    struct chip8_script script = {0};
+    if (keys_filename && chip8_script_load(&script, keys_filename) != 0)
+    {
+        fprintf(stderr, "Invalid input script: %s\n", keys_filename);
+        return(-1);
+    }
+    struct chip8_script_writer writer = {0};
+    if (record_keys_filename && 
+        chip8_script_create(&writer, record_keys_filename) != 0)
+    {
+        fprintf(stderr, "Failed to open %s\n", record_keys_filename);
+        return(-1);
+    }
+
+    struct chip8_profile profile = {0};
+    if (profile_filename && chip8_profile_init(&profile, &chip8) != 0)
+    {
+        fprintf(stderr, "Out of memory for the profile\n");
+        return(-1);
+    }
+
+    struct video video;
+    if (video_open(&video, output, format, filter, scale, persistence) != 0)
+    {
+        fprintf(stderr, "Failed to open %s\n", output);
+        video_close(&video);
+        return(-1);
+    }
+
+    for (long frame = 0; frame < frames && !chip8.exited; ++frame)
+    {
+        if (netplay_arg)
+        {
+            uint16_t keys = bot ? bot_keys(bot_seed, frame) : 0;
+            int waited = 0;
+            while (!chip8_netplay_advance(&netplay, keys))
+            {
+                if (++waited > NETPLAY_TIMEOUT_MS)
+                {
+                    fprintf(stderr, "The peer stopped answering\n");
+                    return(-1);
+                }
+                sleep_ms(1);
+            }
+            if (netstats)
+            {
+                fprintf(stderr, "frame %ld: rollback %d, %.3fms\n", frame, 
+                        netplay.stats.rollback_depth, 
+                        netplay.stats.resim_ms);
+            }
+        }
+        else
+        {
+            if (bot)
+            {
+                chip8_keyboard_set_mask(&chip8.keyboard, 
+                                        bot_keys(bot_seed, frame));
+            }
+            else if (keys_filename)
+            {
+                chip8_keyboard_set_mask(&chip8.keyboard, 
+                                        chip8_script_keys(&script, frame));
+            }
+            if (shm_name)
+                chip8_shm_apply_keys(&shm, &chip8);
+            if (record_keys_filename)
+                chip8_script_write(&writer, frame, 
+                                   chip8_keyboard_get_mask(&chip8.keyboard));
+            if (profile_filename)
+                chip8_profile_run_frame(&profile, &chip8);
+            else
+                chip8_run_frame(&chip8);
+        }
+        if (shm_name)
+            chip8_shm_publish(&shm, &chip8, frame + 1);
+
+        if (video_write(&video, &chip8.screen) != 0)
+        {
+            fprintf(stderr, "Failed to write frame %ld\n", frame);
+            video_close(&video);
+            return(-1);
+        }
+    }
+
+    video_close(&video);
+    chip8_shm_close(&shm);
+    chip8_script_free(&script);
+    if (chip8_script_close(&writer) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", record_keys_filename);
+        return(-1);
+    }
+    if (profile_filename)
+    {
+        FILE *file = fopen(profile_filename, "w");
+        if (!file || (chip8_profile_write(&profile, file) | fclose(file)))
+        {
+            fprintf(stderr, "Failed to write %s\n", profile_filename);
+            return(-1);
+        }
+        chip8_profile_print_summary(&profile, stderr, PROFILE_SUMMARY_SIZE);
+        chip8_profile_free(&profile);
+    }
+
+    if (netplay_arg)
+    {
+        /* Wait for the peer's last inputs, then keep answering for a while 
+        so it gets ours. */
+        int waited = 0;
+        while (!chip8_netplay_sync(&netplay) && waited++ < NETPLAY_TIMEOUT_MS)
+            sleep_ms(1);
+        for (int i = 0; i < 250; ++i)
+        {
+            chip8_netplay_sync(&netplay);
+            sleep_ms(1);
+        }
+        print_netplay_stats(&netplay.stats);
+        chip8_netplay_close(&netplay);
+    }
+    if (chip8.memory.code_writes)
+    {
+        fprintf(stderr, "self-modifying: %lu writes to executed code, the "
+                "first at %03X\n", chip8.memory.code_writes, 
+                chip8.memory.first_code_write);
+    }
+    fprintf(stderr, "state %016llx\n", 
+            (unsigned long long)state_hash(&chip8));
+    return(0);
+}
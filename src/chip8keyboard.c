@@ -26,15 +26,37 @@ int chip8_keyboard_map(struct chip8_keyboard *keyboard, char key)
 
 void chip8_keyboard_down(struct chip8_keyboard *keyboard, int key)
 {
+    chip8_keyboard_ensure_in_bounds(key);
     keyboard->keyboard[key] = true;
 }
 
 void chip8_keyboard_up(struct chip8_keyboard *keyboard, int key)
 {
+    chip8_keyboard_ensure_in_bounds(key);
     keyboard->keyboard[key] = false;
 }
 
 _Bool chip8_keyboard_is_down(struct chip8_keyboard *keyboard, int key)
 {
+    chip8_keyboard_ensure_in_bounds(key);
     return keyboard->keyboard[key];    
 }
+
+void chip8_keyboard_set_mask(struct chip8_keyboard *keyboard, uint16_t keys)
+{
+    for (int key = 0; key < CHIP8_TOTAL_KEYS; ++key)
+    {
+        keyboard->keyboard[key] = (keys >> key) & 1;
+    }
+}
+
+uint16_t chip8_keyboard_get_mask(const struct chip8_keyboard *keyboard)
+{
+    uint16_t keys = 0;
+    for (int key = 0; key < CHIP8_TOTAL_KEYS; ++key)
+    {
+        if (keyboard->keyboard[key])
+            keys |= 1 << key;
+    }
+    return keys;
+}
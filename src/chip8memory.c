@@ -1,23 +1,43 @@
 #include "chip8memory.h"
-#include <assert.h>
+#include "chip8hash.h"
 
-static void chip8_is_memory_in_bounds(int index)
+/* I and PC reach all of memory, so accesses running past its end wrap
+around to its start, as in Octo, rather than leave it. */
+static int chip8_memory_wrap(int index)
 {
-    /* Check whether the index is withing the memory bounds. */
-    assert(index >= 0 && index < CHIP8_MEMORY_SIZE);
+    return index & (CHIP8_MEMORY_SIZE - 1);
+}
+
+/* Counts a write to code already executed and calls the hook. Rare, so 
+kept out of chip8_memory_set. */
+static void chip8_memory_code_written(struct chip8_memory *memory, int index)
+{
+    if (memory->code_writes++ == 0)
+        memory->first_code_write = index;
+    if (memory->code_written)
+        memory->code_written(memory->code_written_context, index);
 }
 
 void chip8_memory_set(struct chip8_memory *memory, int index, 
                       unsigned char val)
 {
-    chip8_is_memory_in_bounds(index);
+    index = chip8_memory_wrap(index);
+#ifdef CHIP8_INCREMENTAL_HASH
+    memory->hash ^= chip8_zobrist(index, memory->memory[index]) ^ 
+                    chip8_zobrist(index, val);
+#endif
     memory->memory[index] = val;
+
+    int block = index / CHIP8_CODE_BLOCK_SIZE;
+    unsigned char bit = 1 << (block % 8);
+    memory->written_map[block / 8] |= bit;
+    if (memory->executed_map[block / 8] & bit)
+        chip8_memory_code_written(memory, index);
 }
 
 unsigned char chip8_memory_get(struct chip8_memory *memory, int index)
 {
-    chip8_is_memory_in_bounds(index);
-    return memory->memory[index];
+    return memory->memory[chip8_memory_wrap(index)];
 }
 
 unsigned short chip8_memory_get_short(struct chip8_memory *memory, int index)
@@ -28,3 +48,14 @@ unsigned short chip8_memory_get_short(struct chip8_memory *memory, int index)
     bytes.*/
     return(byte1 << 8 | byte2);
 }
+
+#ifdef CHIP8_INCREMENTAL_HASH
+void chip8_memory_rehash(struct chip8_memory *memory)
+{
+    memory->hash = 0;
+    for (int i = 0; i < CHIP8_MEMORY_SIZE; ++i)
+    {
+        memory->hash ^= chip8_zobrist(i, memory->memory[i]);
+    }
+}
+#endif
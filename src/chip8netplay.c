@@ -0,0 +1,362 @@
+#include "chip8netplay.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define CHIP8_NETPLAY_MAGIC "C8NP"
+#define CHIP8_NETPLAY_HEADER_SIZE 13
+
+/* Inputs in one packet. The peer can lag our frame by up to twice the
+rollback window, once for each side running ahead. */
+#define CHIP8_NETPLAY_MAX_INPUTS (2 * CHIP8_NETPLAY_MAX_ROLLBACK)
+
+static double chip8_netplay_now_ms(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+#endif
+}
+
+static void chip8_netplay_close_socket(intptr_t s)
+{
+#ifdef _WIN32
+    closesocket((SOCKET)s);
+    WSACleanup();
+#else
+    close(s);
+#endif
+}
+
+int chip8_netplay_parse(const char *arg, int *local_port, char *host, 
+                        size_t host_size, int *peer_port)
+{
+    const char *first = strchr(arg, ':');
+    const char *last = strrchr(arg, ':');
+    if (!first || first == last || (size_t)(last - first - 1) >= host_size)
+        return -1;
+
+    *local_port = atoi(arg);
+    *peer_port = atoi(last + 1);
+    memcpy(host, first + 1, last - first - 1);
+    host[last - first - 1] = '\0';
+    return *local_port > 0 && *peer_port > 0 ? 0 : -1;
+}
+
+int chip8_netplay_open(struct chip8_netplay *netplay, struct chip8 *chip8,
+                       int local_port, const char *peer_host, int peer_port)
+{
+    memset(netplay, 0, sizeof(struct chip8_netplay));
+    netplay->chip8 = chip8;
+    netplay->rollback_from = ULLONG_MAX;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        return -1;
+#endif
+
+    struct addrinfo hints = {0};
+    struct addrinfo *peer;
+    char port[8];
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    sprintf(port, "%d", peer_port);
+    if (getaddrinfo(peer_host, port, &hints, &peer) != 0)
+    {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return -1;
+    }
+
+    if (peer->ai_addrlen > sizeof(netplay->peer))
+    {
+        freeaddrinfo(peer);
+        return -1;
+    }
+    memcpy(netplay->peer, peer->ai_addr, peer->ai_addrlen);
+    netplay->peer_size = peer->ai_addrlen;
+    int family = peer->ai_family;
+    freeaddrinfo(peer);
+
+#ifdef _WIN32
+    SOCKET s = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET)
+    {
+        WSACleanup();
+        return -1;
+    }
+#else
+    int s = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0)
+        return -1;
+#endif
+    netplay->socket = (intptr_t)s;
+
+    /* Listen on the same family as the peer, any address. */
+    struct sockaddr_storage local = {0};
+    socklen_t local_size;
+    if (family == AF_INET6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&local;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(local_port);
+        in6->sin6_addr = in6addr_any;
+        local_size = sizeof(struct sockaddr_in6);
+    }
+    else
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)&local;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(local_port);
+        in->sin_addr.s_addr = htonl(INADDR_ANY);
+        local_size = sizeof(struct sockaddr_in);
+    }
+
+#ifdef _WIN32
+    u_long nonblocking = 1;
+    int res = ioctlsocket(s, FIONBIO, &nonblocking);
+#else
+    int res = fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+#endif
+    if (res != 0 || bind(s, (struct sockaddr *)&local, local_size) != 0)
+    {
+        chip8_netplay_close_socket(netplay->socket);
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_netplay_close(struct chip8_netplay *netplay)
+{
+    chip8_netplay_close_socket(netplay->socket);
+}
+
+static void chip8_netplay_put32(unsigned char *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t chip8_netplay_get32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+/* Sends every local input the peer hasn't acknowledged. */
+static void chip8_netplay_send(struct chip8_netplay *netplay)
+{
+    unsigned char packet[CHIP8_NETPLAY_HEADER_SIZE +
+                         2 * CHIP8_NETPLAY_MAX_INPUTS];
+    unsigned long long first = netplay->peer_ack;
+    unsigned long long count = netplay->frame - first;
+    if (count > CHIP8_NETPLAY_MAX_INPUTS)
+        count = CHIP8_NETPLAY_MAX_INPUTS;
+
+    memcpy(packet, CHIP8_NETPLAY_MAGIC, 4);
+    chip8_netplay_put32(packet + 4, first);
+    chip8_netplay_put32(packet + 8, netplay->remote_confirmed);
+    packet[12] = count;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        uint16_t keys = netplay->local_inputs[(first + i) %
+                                              CHIP8_NETPLAY_INPUT_HISTORY];
+        packet[CHIP8_NETPLAY_HEADER_SIZE + 2 * i] = keys;
+        packet[CHIP8_NETPLAY_HEADER_SIZE + 2 * i + 1] = keys >> 8;
+    }
+
+    /* Lost packets are fine, the next one repeats the inputs. */
+    sendto(netplay->socket, (const char *)packet,
+           CHIP8_NETPLAY_HEADER_SIZE + 2 * count, 0,
+           (struct sockaddr *)netplay->peer, netplay->peer_size);
+}
+
+/* Stores the inputs of one packet. */
+static void chip8_netplay_handle(struct chip8_netplay *netplay,
+                                 const unsigned char *packet, int size)
+{
+    if (size < CHIP8_NETPLAY_HEADER_SIZE ||
+        memcmp(packet, CHIP8_NETPLAY_MAGIC, 4) != 0 ||
+        size < CHIP8_NETPLAY_HEADER_SIZE + 2 * packet[12])
+        return;
+
+    unsigned long long first = chip8_netplay_get32(packet + 4);
+    unsigned long long ack = chip8_netplay_get32(packet + 8);
+    if (ack > netplay->peer_ack && ack <= netplay->frame)
+        netplay->peer_ack = ack;
+
+    for (int i = 0; i < packet[12]; ++i)
+    {
+        unsigned long long frame = first + i;
+
+        /* Keep the slots of the frames we may still roll back to. */
+        if (frame < netplay->remote_confirmed ||
+            frame >= netplay->frame + CHIP8_NETPLAY_INPUT_HISTORY -
+                     CHIP8_NETPLAY_MAX_ROLLBACK)
+            continue;
+
+        int slot = frame % CHIP8_NETPLAY_INPUT_HISTORY;
+        netplay->remote_inputs[slot] = packet[CHIP8_NETPLAY_HEADER_SIZE +
+                                              2 * i] |
+            packet[CHIP8_NETPLAY_HEADER_SIZE + 2 * i + 1] << 8;
+        netplay->remote_known[slot] = true;
+    }
+
+    /* Confirm what's now contiguous, and find the frames that ran with a
+    wrong prediction. */
+    while (1)
+    {
+        unsigned long long frame = netplay->remote_confirmed;
+        int slot = frame % CHIP8_NETPLAY_INPUT_HISTORY;
+        if (!netplay->remote_known[slot])
+            break;
+
+        netplay->remote_known[slot] = false;
+        if (frame < netplay->frame && frame < netplay->rollback_from &&
+            netplay->remote_inputs[slot] != netplay->predicted[slot])
+            netplay->rollback_from = frame;
+        netplay->remote_confirmed++;
+    }
+}
+
+static void chip8_netplay_receive(struct chip8_netplay *netplay)
+{
+    unsigned char packet[CHIP8_NETPLAY_HEADER_SIZE +
+                         2 * CHIP8_NETPLAY_MAX_INPUTS];
+    while (1)
+    {
+        struct sockaddr_storage from;
+        socklen_t from_size = sizeof(from);
+        int size = recvfrom(netplay->socket, (char *)packet, sizeof(packet),
+                            0, (struct sockaddr *)&from, &from_size);
+        if (size < 0)
+        {
+#ifdef _WIN32
+            /* An ICMP unreachable from an earlier send, not fatal. */
+            if (WSAGetLastError() == WSAECONNRESET)
+                continue;
+#endif
+            break;
+        }
+
+        /* Ignore anyone but the peer. */
+        if ((int)from_size != netplay->peer_size ||
+            memcmp(&from, netplay->peer, from_size) != 0)
+            continue;
+        chip8_netplay_handle(netplay, packet, size);
+    }
+}
+
+/* The peer's input for a frame, or its last known input as a prediction. */
+static uint16_t chip8_netplay_remote_input(struct chip8_netplay *netplay,
+                                           unsigned long long frame)
+{
+    int slot = frame % CHIP8_NETPLAY_INPUT_HISTORY;
+    if (frame < netplay->remote_confirmed || netplay->remote_known[slot])
+        return netplay->remote_inputs[slot];
+    if (netplay->remote_confirmed == 0)
+        return 0;
+    return netplay->remote_inputs[(netplay->remote_confirmed - 1) %
+                                  CHIP8_NETPLAY_INPUT_HISTORY];
+}
+
+/* Snapshots the chip8 and runs "frame" with both inputs. */
+static void chip8_netplay_run(struct chip8_netplay *netplay,
+                              unsigned long long frame)
+{
+    struct chip8 *chip8 = netplay->chip8;
+    int slot = frame % CHIP8_NETPLAY_INPUT_HISTORY;
+    netplay->snapshots[frame % CHIP8_NETPLAY_MAX_ROLLBACK] = *chip8;
+
+    uint16_t remote = chip8_netplay_remote_input(netplay, frame);
+    netplay->predicted[slot] = remote;
+    chip8_keyboard_set_mask(&chip8->keyboard, 
+                            netplay->local_inputs[slot] | remote);
+    chip8_run_frame(chip8);
+}
+
+/* Restores the snapshot before the first mispredicted frame and runs the
+frames since with the inputs now known. */
+static void chip8_netplay_rollback(struct chip8_netplay *netplay)
+{
+    struct chip8_netplay_stats *stats = &netplay->stats;
+    stats->rollback_depth = 0;
+    stats->resim_ms = 0;
+    if (netplay->rollback_from >= netplay->frame)
+    {
+        netplay->rollback_from = ULLONG_MAX;
+        return;
+    }
+
+    double start = chip8_netplay_now_ms();
+    unsigned long long from = netplay->rollback_from;
+    *netplay->chip8 = netplay->snapshots[from % CHIP8_NETPLAY_MAX_ROLLBACK];
+    for (unsigned long long frame = from; frame < netplay->frame; ++frame)
+    {
+        chip8_netplay_run(netplay, frame);
+    }
+    netplay->rollback_from = ULLONG_MAX;
+
+    stats->rollback_depth = netplay->frame - from;
+    stats->resim_ms = chip8_netplay_now_ms() - start;
+    stats->rollbacks++;
+    stats->resimulated_frames += stats->rollback_depth;
+    stats->total_resim_ms += stats->resim_ms;
+    if (stats->rollback_depth > stats->max_rollback_depth)
+        stats->max_rollback_depth = stats->rollback_depth;
+}
+
+int chip8_netplay_advance(struct chip8_netplay *netplay, uint16_t keys)
+{
+    chip8_netplay_receive(netplay);
+    chip8_netplay_rollback(netplay);
+
+    /* Past the window a wrong prediction could no longer be undone. */
+    if (netplay->frame >= netplay->remote_confirmed +
+                          CHIP8_NETPLAY_MAX_ROLLBACK)
+    {
+        netplay->stats.stalls++;
+        chip8_netplay_send(netplay);
+        return 0;
+    }
+
+    netplay->local_inputs[netplay->frame % CHIP8_NETPLAY_INPUT_HISTORY] =
+        keys;
+    chip8_netplay_run(netplay, netplay->frame);
+    netplay->frame++;
+    netplay->stats.frames++;
+    chip8_netplay_send(netplay);
+    return 1;
+}
+
+bool chip8_netplay_sync(struct chip8_netplay *netplay)
+{
+    chip8_netplay_receive(netplay);
+    chip8_netplay_rollback(netplay);
+    chip8_netplay_send(netplay);
+    return netplay->remote_confirmed >= netplay->frame;
+}
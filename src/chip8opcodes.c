@@ -0,0 +1,45 @@
+#include "chip8opcodes.h"
+#include <stdbool.h>
+
+#define CHIP8_OPCODE_ENTRY(name, mask, pattern, format) \
+    { mask, pattern, format },
+
+const struct chip8_opcode chip8_opcodes[CHIP8_TOTAL_OPS] =
+{
+    { 0x0000, 0xffff, "DW %oooo" },  /* CHIP8_OP_UNKNOWN never matches. */
+    CHIP8_OPCODE_TABLE(CHIP8_OPCODE_ENTRY)
+};
+
+unsigned char chip8_opcode_lookup[0x10000];
+
+/* 0 until a caller claims the table, 1 while it fills it and 2 once it is 
+ready. Other callers wait for the fill, so threads may race to initialise. */
+static int chip8_opcodes_state = 0;
+
+void chip8_opcodes_init(void)
+{
+    int expected = 0;
+    if (!__atomic_compare_exchange_n(&chip8_opcodes_state, &expected, 1, 
+                                     false, __ATOMIC_ACQUIRE, 
+                                     __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&chip8_opcodes_state, __ATOMIC_ACQUIRE) != 2)
+            ;
+        return;
+    }
+
+    for (int opcode = 0; opcode < 0x10000; ++opcode)
+    {
+        unsigned char op = CHIP8_OP_UNKNOWN;
+        for (int i = 1; i < CHIP8_TOTAL_OPS; ++i)
+        {
+            if ((opcode & chip8_opcodes[i].mask) == chip8_opcodes[i].pattern)
+            {
+                op = i;
+                break;
+            }
+        }
+        chip8_opcode_lookup[opcode] = op;
+    }
+    __atomic_store_n(&chip8_opcodes_state, 2, __ATOMIC_RELEASE);
+}
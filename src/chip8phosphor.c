@@ -0,0 +1,58 @@
+#include "chip8phosphor.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int chip8_phosphor_init(struct chip8_phosphor *phosphor, size_t size,
+                        int persistence)
+{
+    memset(phosphor, 0, sizeof(struct chip8_phosphor));
+    if (persistence < 0 || persistence > 99)
+        return -1;
+    phosphor->levels = calloc(size, 1);
+    if (!phosphor->levels)
+        return -1;
+    phosphor->size = size;
+    phosphor->decay = persistence * 256 / 100;
+    return 0;
+}
+
+void chip8_phosphor_blend(struct chip8_phosphor *phosphor,
+                          unsigned char *image)
+{
+    unsigned char *levels = phosphor->levels;
+    int decay = phosphor->decay;
+    size_t i = 0;
+#ifdef __SSE2__
+    /* Levels are widened to 16 bits for the multiply, sixteen at a time. */
+    __m128i factor = _mm_set1_epi16(decay);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= phosphor->size; i += 16)
+    {
+        __m128i last = _mm_loadu_si128((const __m128i *)(levels + i));
+        __m128i low = _mm_mullo_epi16(_mm_unpacklo_epi8(last, zero), factor);
+        __m128i high = _mm_mullo_epi16(_mm_unpackhi_epi8(last, zero), factor);
+        __m128i faded = _mm_packus_epi16(_mm_srli_epi16(low, 8),
+                                         _mm_srli_epi16(high, 8));
+        __m128i level = _mm_max_epu8(
+            _mm_loadu_si128((const __m128i *)(image + i)), faded);
+        _mm_storeu_si128((__m128i *)(levels + i), level);
+        _mm_storeu_si128((__m128i *)(image + i), level);
+    }
+#endif
+    for (; i < phosphor->size; ++i)
+    {
+        int faded = levels[i] * decay >> 8;
+        if (image[i] < faded)
+            image[i] = faded;
+        levels[i] = image[i];
+    }
+}
+
+void chip8_phosphor_free(struct chip8_phosphor *phosphor)
+{
+    free(phosphor->levels);
+    memset(phosphor, 0, sizeof(struct chip8_phosphor));
+}
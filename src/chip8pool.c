@@ -0,0 +1,54 @@
+#include "chip8pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+struct chip8_pool
+{
+    int count;
+    int next;
+    size_t workspace_size;
+    void (*work)(void *workspace, int index);
+};
+
+static void *chip8_pool_worker(void *arg)
+{
+    struct chip8_pool *pool = arg;
+    void *workspace = calloc(1, pool->workspace_size);
+    if (!workspace)
+        return NULL;
+
+    int i;
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+           pool->count)
+    {
+        pool->work(workspace, i);
+    }
+    free(workspace);
+    return NULL;
+}
+
+int chip8_pool_run(int threads, int count, size_t workspace_size,
+                   void (*work)(void *workspace, int index))
+{
+    struct chip8_pool pool = {count, 0, workspace_size, work};
+    if (threads > CHIP8_POOL_MAX_THREADS)
+        threads = CHIP8_POOL_MAX_THREADS;
+    if (threads > count)
+        threads = count;
+
+    pthread_t ids[CHIP8_POOL_MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        if (pthread_create(&ids[started], NULL, chip8_pool_worker, &pool) 
+            == 0)
+        {
+            started++;
+        }
+    }
+    for (int i = 0; i < started; ++i)
+    {
+        pthread_join(ids[i], NULL);
+    }
+    return pool.next < count ? -1 : 0;
+}
@@ -0,0 +1,213 @@
+#include "chip8profile.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The entry point and one subroutine per stack level. */
+#define MAX_PATH_DEPTH (CHIP8_TOTAL_STACK_DEPTH + 1)
+
+static int chip8_profile_add_node(struct chip8_profile *profile,
+                                  unsigned short address, int parent)
+{
+    if (profile->count == profile->capacity)
+    {
+        int capacity = profile->capacity ? profile->capacity * 2 : 256;
+        struct chip8_profile_node *nodes = realloc(profile->nodes,
+            capacity * sizeof(struct chip8_profile_node));
+        if (!nodes)
+            return -1;
+        profile->nodes = nodes;
+        profile->capacity = capacity;
+    }
+
+    int index = profile->count++;
+    struct chip8_profile_node *node = &profile->nodes[index];
+    node->address = address;
+    node->parent = parent;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->self = 0;
+    if (parent >= 0)
+    {
+        node->next_sibling = profile->nodes[parent].first_child;
+        profile->nodes[parent].first_child = index;
+    }
+    return index;
+}
+
+int chip8_profile_init(struct chip8_profile *profile,
+                       const struct chip8 *chip8)
+{
+    memset(profile, 0, sizeof(struct chip8_profile));
+    profile->sp = chip8->registers.SP;
+    return chip8_profile_add_node(profile, chip8->registers.PC, -1) < 0 ?
+           -1 : 0;
+}
+
+/* Returns the node for "address" called from "parent", adding it the first
+time, or -1 when out of memory. */
+static int chip8_profile_callee(struct chip8_profile *profile, int parent,
+                                unsigned short address)
+{
+    for (int child = profile->nodes[parent].first_child; child >= 0;
+         child = profile->nodes[child].next_sibling)
+    {
+        if (profile->nodes[child].address == address)
+            return child;
+    }
+    return chip8_profile_add_node(profile, address, parent);
+}
+
+void chip8_profile_record(struct chip8_profile *profile,
+                          const struct chip8 *chip8)
+{
+    profile->nodes[profile->current].self++;
+
+    unsigned char sp = chip8->registers.SP;
+    if (sp == profile->sp)
+        return;
+
+    /* A call lands on its subroutine, a return goes back to the caller.
+    Returns past the entry point stay there. */
+    if (sp == (unsigned char)(profile->sp + 1))
+    {
+        int callee = profile->untracked ? -1 : 
+            chip8_profile_callee(profile, profile->current, 
+                                 chip8->registers.PC);
+        if (callee < 0)
+        {
+            profile->truncated = true;
+            profile->untracked++;
+        }
+        else
+        {
+            profile->current = callee;
+        }
+    }
+    else if (sp == (unsigned char)(profile->sp - 1))
+    {
+        if (profile->untracked)
+            profile->untracked--;
+        else if (profile->nodes[profile->current].parent >= 0)
+            profile->current = profile->nodes[profile->current].parent;
+    }
+    profile->sp = sp;
+}
+
+enum chip8_stop_reason chip8_profile_run_frame(struct chip8_profile *profile,
+                                               struct chip8 *chip8)
+{
+    for (int i = 0; i < chip8->instructions_per_frame; ++i)
+    {
+        chip8_step(chip8);
+        chip8_profile_record(profile, chip8);
+    }
+    chip8_end_frame(chip8);
+    return chip8->exited ? CHIP8_STOP_EXIT : CHIP8_STOP_BUDGET;
+}
+
+int chip8_profile_write(const struct chip8_profile *profile, FILE *file)
+{
+    for (int i = 0; i < profile->count; ++i)
+    {
+        if (profile->nodes[i].self == 0)
+            continue;
+
+        unsigned short path[MAX_PATH_DEPTH];
+        int depth = 0;
+        for (int node = i; node >= 0 && depth < MAX_PATH_DEPTH;
+             node = profile->nodes[node].parent)
+        {
+            path[depth++] = profile->nodes[node].address;
+        }
+        while (depth-- > 0)
+        {
+            fprintf(file, depth ? "%03X;" : "%03X", path[depth]);
+        }
+        fprintf(file, " %llu\n", profile->nodes[i].self);
+    }
+    return ferror(file) ? -1 : 0;
+}
+
+struct chip8_profile_entry
+{
+    unsigned short address;
+    unsigned long long inclusive;
+    unsigned long long exclusive;
+};
+
+static int chip8_profile_compare(const void *a, const void *b)
+{
+    const struct chip8_profile_entry *x = a;
+    const struct chip8_profile_entry *y = b;
+    if (x->inclusive != y->inclusive)
+        return x->inclusive < y->inclusive ? 1 : -1;
+    return x->address - y->address;
+}
+
+void chip8_profile_print_summary(const struct chip8_profile *profile,
+                                 FILE *file, int count)
+{
+    unsigned long long *totals = calloc(profile->count,
+                                        sizeof(unsigned long long));
+    struct chip8_profile_entry *entries = calloc(CHIP8_MEMORY_SIZE,
+        sizeof(struct chip8_profile_entry));
+    if (!totals || !entries)
+    {
+        free(totals);
+        free(entries);
+        return;
+    }
+
+    /* Children come after their parents, so going backwards each node's
+    total is complete before it's added to its parent. */
+    for (int i = profile->count - 1; i >= 0; --i)
+    {
+        const struct chip8_profile_node *node = &profile->nodes[i];
+        totals[i] += node->self;
+        if (node->parent >= 0)
+            totals[node->parent] += totals[i];
+        entries[node->address].exclusive += node->self;
+
+        /* Recursive calls are already counted by the outer one. */
+        bool nested = false;
+        for (int up = node->parent; up >= 0 && !nested;
+             up = profile->nodes[up].parent)
+        {
+            nested = profile->nodes[up].address == node->address;
+        }
+        if (!nested)
+            entries[node->address].inclusive += totals[i];
+    }
+    unsigned long long all = totals[0];
+
+    int used = 0;
+    for (int address = 0; address < CHIP8_MEMORY_SIZE; ++address)
+    {
+        if (entries[address].inclusive == 0)
+            continue;
+        entries[address].address = address;
+        entries[used++] = entries[address];
+    }
+    qsort(entries, used, sizeof(struct chip8_profile_entry),
+          chip8_profile_compare);
+
+    fprintf(file, "%llu instructions%s\n", all,
+            profile->truncated ? ", calls past running out of memory "
+            "counted in their caller" : "");
+    fprintf(file, "subroutine     inclusive              exclusive\n");
+    for (int i = 0; i < used && i < count; ++i)
+    {
+        fprintf(file, "%03X   %14llu %5.1f%% %14llu %5.1f%%\n",
+                entries[i].address, entries[i].inclusive,
+                100.0 * entries[i].inclusive / all, entries[i].exclusive,
+                100.0 * entries[i].exclusive / all);
+    }
+    free(totals);
+    free(entries);
+}
+
+void chip8_profile_free(struct chip8_profile *profile)
+{
+    free(profile->nodes);
+    memset(profile, 0, sizeof(struct chip8_profile));
+}
@@ -0,0 +1,46 @@
+#include "chip8quirks.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct chip8_quirks_profile
+{
+    const char *name;
+    int quirks;
+};
+
+static const struct chip8_quirks_profile chip8_quirks_profiles[] =
+{
+    { "default", CHIP8_PROFILE_DEFAULT },
+    { "cosmac",  CHIP8_PROFILE_COSMAC },
+    { "schip",   CHIP8_PROFILE_SCHIP },
+    { "xochip",  CHIP8_PROFILE_XOCHIP }
+};
+
+#define CHIP8_TOTAL_PROFILES \
+    (sizeof(chip8_quirks_profiles) / sizeof(chip8_quirks_profiles[0]))
+
+int chip8_quirks_parse(const char *name)
+{
+    for (size_t i = 0; i < CHIP8_TOTAL_PROFILES; ++i)
+    {
+        if (strcmp(name, chip8_quirks_profiles[i].name) == 0)
+            return chip8_quirks_profiles[i].quirks;
+    }
+
+    char *end;
+    long quirks = strtol(name, &end, 0);
+    if (*name == '\0' || *end != '\0' || quirks < 0 ||
+        quirks >= CHIP8_TOTAL_QUIRK_PROFILES)
+        return -1;
+    return quirks;
+}
+
+const char *chip8_quirks_name(int quirks)
+{
+    for (size_t i = 0; i < CHIP8_TOTAL_PROFILES; ++i)
+    {
+        if (chip8_quirks_profiles[i].quirks == quirks)
+            return chip8_quirks_profiles[i].name;
+    }
+    return NULL;
+}
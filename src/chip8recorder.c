@@ -0,0 +1,353 @@
+#include "chip8recorder.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHIP8_GIF_MIN_CODE_SIZE 2
+#define CHIP8_GIF_CLEAR_CODE (1 << CHIP8_GIF_MIN_CODE_SIZE)
+#define CHIP8_GIF_END_CODE (CHIP8_GIF_CLEAR_CODE + 1)
+#define CHIP8_GIF_MAX_CODES 4096
+
+#define CHIP8_GIF_WIDTH CHIP8_HIRES_WIDTH
+#define CHIP8_GIF_HEIGHT CHIP8_HIRES_HEIGHT
+
+/* Same colours as the window, black and white for plain Chip-8. */
+static const unsigned char chip8_gif_palette[1 << CHIP8_TOTAL_PLANES][3] = 
+{
+    {0, 0, 0}, {255, 255, 255}, {170, 170, 170}, {85, 85, 85}
+};
+
+/* One colour index per pixel, at the high resolution. */
+typedef unsigned char chip8_gif_canvas[CHIP8_GIF_HEIGHT][CHIP8_GIF_WIDTH];
+
+/* Worker state. */
+struct chip8_gif
+{
+    FILE *file;
+    int scale;
+
+    /* What the GIF shows so far, and the frame waiting for its duration. */
+    chip8_gif_canvas shown;
+    chip8_gif_canvas current;
+    chip8_gif_canvas pending;
+    unsigned long long pending_number;
+    bool has_pending;
+
+    /* LZW dictionary, next[code][colour] being the code of the string 
+    "code" followed by "colour", or 0. */
+    uint16_t next[CHIP8_GIF_MAX_CODES][1 << CHIP8_TOTAL_PLANES];
+    int max_code;
+    int code_size;
+    uint32_t bits;
+    int bit_count;
+    unsigned char block[255];
+    int block_size;
+};
+
+static void chip8_gif_put16(FILE *file, int value)
+{
+    fputc(value & 0xff, file);
+    fputc(value >> 8, file);
+}
+
+static void chip8_gif_write_header(struct chip8_gif *gif)
+{
+    fwrite("GIF89a", 6, 1, gif->file);
+    chip8_gif_put16(gif->file, CHIP8_GIF_WIDTH * gif->scale);
+    chip8_gif_put16(gif->file, CHIP8_GIF_HEIGHT * gif->scale);
+
+    /* Global colour table of 4 entries, 2 bits per primary colour. */
+    fputc(0x91, gif->file);
+    fputc(0, gif->file);
+    fputc(0, gif->file);
+    fwrite(chip8_gif_palette, sizeof(chip8_gif_palette), 1, gif->file);
+
+    /* Loop forever. */
+    fwrite("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 19, 1, gif->file);
+}
+
+static void chip8_gif_flush_block(struct chip8_gif *gif)
+{
+    if (gif->block_size == 0)
+        return;
+    fputc(gif->block_size, gif->file);
+    fwrite(gif->block, gif->block_size, 1, gif->file);
+    gif->block_size = 0;
+}
+
+static void chip8_gif_write_code(struct chip8_gif *gif, int code)
+{
+    gif->bits |= (uint32_t)code << gif->bit_count;
+    gif->bit_count += gif->code_size;
+    while (gif->bit_count >= 8)
+    {
+        gif->block[gif->block_size++] = gif->bits & 0xff;
+        if (gif->block_size == sizeof(gif->block))
+            chip8_gif_flush_block(gif);
+        gif->bits >>= 8;
+        gif->bit_count -= 8;
+    }
+}
+
+static void chip8_gif_reset_codes(struct chip8_gif *gif)
+{
+    memset(gif->next, 0, sizeof(gif->next));
+    gif->code_size = CHIP8_GIF_MIN_CODE_SIZE + 1;
+    gif->max_code = CHIP8_GIF_END_CODE;
+}
+
+/* LZW compresses the rectangle of "canvas" at (x, y) of size w x h, in 
+canvas pixels, scaling it up on the fly. */
+static void chip8_gif_write_pixels(struct chip8_gif *gif, 
+                                   const chip8_gif_canvas canvas, 
+                                   int x, int y, int w, int h)
+{
+    int scale = gif->scale;
+    gif->bits = 0;
+    gif->bit_count = 0;
+    gif->block_size = 0;
+    fputc(CHIP8_GIF_MIN_CODE_SIZE, gif->file);
+
+    chip8_gif_reset_codes(gif);
+    chip8_gif_write_code(gif, CHIP8_GIF_CLEAR_CODE);
+
+    int prefix = -1;
+    for (int py = y * scale; py < (y + h) * scale; ++py)
+    {
+        const unsigned char *row = canvas[py / scale];
+        for (int px = x * scale; px < (x + w) * scale; ++px)
+        {
+            int colour = row[px / scale];
+            if (prefix < 0)
+            {
+                prefix = colour;
+                continue;
+            }
+
+            if (gif->next[prefix][colour])
+            {
+                prefix = gif->next[prefix][colour];
+                continue;
+            }
+
+            chip8_gif_write_code(gif, prefix);
+            gif->next[prefix][colour] = ++gif->max_code;
+            if (gif->max_code >= (1 << gif->code_size))
+                gif->code_size++;
+            if (gif->max_code == CHIP8_GIF_MAX_CODES - 1)
+            {
+                chip8_gif_write_code(gif, CHIP8_GIF_CLEAR_CODE);
+                chip8_gif_reset_codes(gif);
+            }
+            prefix = colour;
+        }
+    }
+
+    chip8_gif_write_code(gif, prefix);
+    chip8_gif_write_code(gif, CHIP8_GIF_END_CODE);
+    if (gif->bit_count > 0)
+        gif->block[gif->block_size++] = gif->bits & 0xff;
+    chip8_gif_flush_block(gif);
+    fputc(0, gif->file);
+}
+
+/* Writes the pending frame, shown from its own number until "until". */
+static void chip8_gif_write_pending(struct chip8_gif *gif, 
+                                    unsigned long long until)
+{
+    /* Find what changed since the last frame written. */
+    int x0 = CHIP8_GIF_WIDTH, y0 = CHIP8_GIF_HEIGHT, x1 = -1, y1 = -1;
+    for (int y = 0; y < CHIP8_GIF_HEIGHT; ++y)
+    {
+        for (int x = 0; x < CHIP8_GIF_WIDTH; ++x)
+        {
+            if (gif->pending[y][x] == gif->shown[y][x])
+                continue;
+            x0 = x < x0 ? x : x0;
+            x1 = x > x1 ? x : x1;
+            y0 = y < y0 ? y : y0;
+            y1 = y;
+        }
+    }
+    if (x1 < 0)
+    {
+        /* Nothing changed, keep a single pixel to carry the delay. */
+        x0 = x1 = y0 = y1 = 0;
+    }
+
+    /* Delays are in 1/100s, rounded from the frame numbers so they don't 
+    drift. Viewers show anything under 2 as 10, so that's the minimum. */
+    unsigned long long start = gif->pending_number;
+    int delay = until * 100 / CHIP8_FRAMES_PER_SECOND - 
+                start * 100 / CHIP8_FRAMES_PER_SECOND;
+    if (delay < 2)
+        delay = 2;
+    if (delay > 0xffff)
+        delay = 0xffff;
+
+    /* Graphic control extension: leave the frame in place for the next. */
+    fwrite("\x21\xf9\x04\x04", 4, 1, gif->file);
+    chip8_gif_put16(gif->file, delay);
+    fputc(0, gif->file);
+    fputc(0, gif->file);
+
+    int scale = gif->scale;
+    fputc(0x2c, gif->file);
+    chip8_gif_put16(gif->file, x0 * scale);
+    chip8_gif_put16(gif->file, y0 * scale);
+    chip8_gif_put16(gif->file, (x1 - x0 + 1) * scale);
+    chip8_gif_put16(gif->file, (y1 - y0 + 1) * scale);
+    fputc(0, gif->file);
+    chip8_gif_write_pixels(gif, (const unsigned char (*)[CHIP8_GIF_WIDTH])
+                           gif->pending, x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+
+    memcpy(gif->shown, gif->pending, sizeof(gif->shown));
+}
+
+static void chip8_gif_render(const struct chip8_recorder_frame *frame, 
+                             chip8_gif_canvas canvas)
+{
+    /* Low resolution pixels cover 2x2 canvas pixels. */
+    int shift = frame->hires ? 0 : 1;
+    for (int y = 0; y < CHIP8_GIF_HEIGHT; ++y)
+    {
+        for (int x = 0; x < CHIP8_GIF_WIDTH; ++x)
+        {
+            int sx = x >> shift;
+            int sy = y >> shift;
+            int colour = 0;
+            for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+            {
+                uint64_t word = frame->rows[plane][sy][sx / 64];
+                colour |= ((word >> (63 - sx % 64)) & 1) << plane;
+            }
+            canvas[y][x] = colour;
+        }
+    }
+}
+
+static void chip8_gif_add_frame(struct chip8_gif *gif, 
+                                const struct chip8_recorder_frame *frame)
+{
+    chip8_gif_render(frame, gif->current);
+    if (gif->has_pending)
+    {
+        if (memcmp(gif->current, gif->pending, sizeof(gif->current)) == 0)
+            return;
+        chip8_gif_write_pending(gif, frame->number);
+    }
+    memcpy(gif->pending, gif->current, sizeof(gif->current));
+    gif->pending_number = frame->number;
+    gif->has_pending = true;
+}
+
+static int chip8_recorder_worker(void *data)
+{
+    struct chip8_recorder *recorder = data;
+    struct chip8_gif *gif = calloc(1, sizeof(struct chip8_gif));
+    if (!gif)
+    {
+        /* Nothing drains the queue, frames are dropped from now on. */
+        recorder->error = -1;
+        return -1;
+    }
+    gif->file = recorder->file;
+    gif->scale = recorder->scale;
+    chip8_gif_write_header(gif);
+
+    unsigned long long last = 0;
+    while (1)
+    {
+        unsigned int tail = SDL_AtomicGet(&recorder->tail);
+        if (tail == (unsigned int)SDL_AtomicGet(&recorder->head))
+        {
+            /* Stop is only read once the queue is seen empty, so every 
+            frame pushed before chip8_recorder_close is written. */
+            if (SDL_AtomicGet(&recorder->stop))
+            {
+                if (tail == (unsigned int)SDL_AtomicGet(&recorder->head))
+                    break;
+                continue;
+            }
+            SDL_Delay(1);
+            continue;
+        }
+
+        const struct chip8_recorder_frame *frame = 
+            &recorder->frames[tail % CHIP8_RECORDER_QUEUE_SIZE];
+        chip8_gif_add_frame(gif, frame);
+        last = frame->number;
+
+        /* SDL_AtomicSet is a full barrier, the slot is read before it's 
+        handed back to the emulation thread. */
+        SDL_AtomicSet(&recorder->tail, tail + 1);
+    }
+
+    if (gif->has_pending)
+        chip8_gif_write_pending(gif, last + 1);
+    fputc(0x3b, gif->file);
+    free(gif);
+    return 0;
+}
+
+int chip8_recorder_open(struct chip8_recorder *recorder, const char *filename,
+                        int scale)
+{
+    if (scale < 1 || CHIP8_GIF_WIDTH * scale > 0xffff)
+        return -1;
+
+    recorder->file = fopen(filename, "wb");
+    if (!recorder->file)
+        return -1;
+
+    SDL_AtomicSet(&recorder->head, 0);
+    SDL_AtomicSet(&recorder->tail, 0);
+    SDL_AtomicSet(&recorder->stop, 0);
+    recorder->dropped = 0;
+    recorder->scale = scale;
+    recorder->error = 0;
+    recorder->thread = SDL_CreateThread(chip8_recorder_worker, 
+                                        "chip8_recorder", recorder);
+    if (!recorder->thread)
+    {
+        fclose(recorder->file);
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_recorder_push(struct chip8_recorder *recorder, 
+                         const struct chip8_screen *screen, 
+                         unsigned long long number)
+{
+    unsigned int head = SDL_AtomicGet(&recorder->head);
+    unsigned int tail = SDL_AtomicGet(&recorder->tail);
+    if (head - tail == CHIP8_RECORDER_QUEUE_SIZE)
+    {
+        recorder->dropped++;
+        return;
+    }
+
+    struct chip8_recorder_frame *frame = 
+        &recorder->frames[head % CHIP8_RECORDER_QUEUE_SIZE];
+    frame->number = number;
+    frame->hires = screen->hires;
+    memcpy(frame->rows, screen->rows, sizeof(frame->rows));
+
+    /* Publish the slot, SDL_AtomicSet orders the copy before it. */
+    SDL_AtomicSet(&recorder->head, head + 1);
+}
+
+int chip8_recorder_close(struct chip8_recorder *recorder)
+{
+    SDL_AtomicSet(&recorder->stop, 1);
+    SDL_WaitThread(recorder->thread, NULL);
+    recorder->thread = NULL;
+
+    int res = recorder->error;
+    if (ferror(recorder->file))
+        res = -1;
+    if (fclose(recorder->file) != 0)
+        res = -1;
+    recorder->file = NULL;
+    return res;
+}
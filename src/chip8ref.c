@@ -0,0 +1,329 @@
+#include "chip8ref.h"
+#include "chip8hash.h"
+#include <string.h>
+
+void chip8_ref_from_chip8(struct chip8_ref *ref, const struct chip8 *chip8)
+{
+    memset(ref, 0, sizeof(struct chip8_ref));
+    memcpy(ref->memory, chip8->memory.memory, sizeof(ref->memory));
+    memcpy(ref->V, chip8->registers.V, sizeof(ref->V));
+    ref->I = chip8->registers.I;
+    ref->PC = chip8->registers.PC;
+    ref->SP = chip8->registers.SP;
+    memcpy(ref->stack, chip8->stack.stack, sizeof(ref->stack));
+    ref->delay_timer = chip8_delay_timer(chip8);
+    ref->sound_timer = chip8_sound_timer(chip8);
+    for (int y = 0; y < CHIP8_HEIGHT; ++y)
+    {
+        for (int x = 0; x < CHIP8_WIDTH; ++x)
+        {
+            ref->display[y][x] = (chip8->screen.rows[0][y][0] >>
+                                  (63 - x)) & 1;
+        }
+    }
+    memcpy(ref->keys, chip8->keyboard.keyboard, sizeof(ref->keys));
+    ref->random = chip8->random;
+}
+
+/* True when "size" bytes from "address" are all in memory. */
+static bool chip8_ref_in_memory(int address, int size)
+{
+    return address + size <= CHIP8_MEMORY_SIZE;
+}
+
+static unsigned char chip8_ref_random(struct chip8_ref *ref)
+{
+    ref->random ^= ref->random << 13;
+    ref->random ^= ref->random >> 17;
+    ref->random ^= ref->random << 5;
+    return ref->random >> 24;
+}
+
+/* "Skip the next instruction" adds 2 to PC. The interpreter would skip all
+four bytes of XO-CHIP's F000, so that case is left alone. */
+static enum chip8_ref_result chip8_ref_skip(struct chip8_ref *ref, bool skip)
+{
+    unsigned short next = ref->PC + 2;
+    if (skip && !chip8_ref_in_memory(next, 2))
+        return CHIP8_REF_UNDEFINED;
+    if (skip && ref->memory[next] == 0xf0 && ref->memory[next + 1] == 0x00)
+        return CHIP8_REF_UNSUPPORTED;
+
+    ref->PC = skip ? next + 2 : next;
+    return CHIP8_REF_OK;
+}
+
+static void chip8_ref_draw(struct chip8_ref *ref, int vx, int vy, int n)
+{
+    /* Sprites are XORed onto the screen, wrapping around its edges. VF is
+    set when any pixel is erased. */
+    bool erased = false;
+    for (int row = 0; row < n; ++row)
+    {
+        unsigned char bits = ref->memory[ref->I + row];
+        for (int column = 0; column < 8; ++column)
+        {
+            if (!(bits & (0x80 >> column)))
+                continue;
+            bool *pixel = &ref->display[(vy + row) % CHIP8_HEIGHT]
+                                       [(vx + column) % CHIP8_WIDTH];
+            if (*pixel)
+                erased = true;
+            *pixel = !*pixel;
+        }
+    }
+    ref->V[0x0f] = erased;
+}
+
+enum chip8_ref_result chip8_ref_step(struct chip8_ref *ref)
+{
+    if (!chip8_ref_in_memory(ref->PC, 2))
+        return CHIP8_REF_UNDEFINED;
+
+    unsigned short opcode = ref->memory[ref->PC] << 8 |
+                            ref->memory[ref->PC + 1];
+    unsigned short nnn = opcode & 0x0fff;
+    int x = (opcode >> 8) & 0x0f;
+    int y = (opcode >> 4) & 0x0f;
+    unsigned char kk = opcode & 0xff;
+    int n = opcode & 0x0f;
+    unsigned char *V = ref->V;
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00e0)               /* CLS */
+        {
+            memset(ref->display, 0, sizeof(ref->display));
+        }
+        else if (opcode == 0x00ee)          /* RET */
+        {
+            if (ref->SP == 0)
+                return CHIP8_REF_UNDEFINED;
+            ref->PC = ref->stack[ref->SP];
+            ref->SP -= 1;
+            return CHIP8_REF_OK;
+        }
+        else if ((opcode & 0xfff0) == 0x00c0 ||
+                 (opcode & 0xfff0) == 0x00d0 || opcode >= 0x00fb)
+        {
+            /* SUPER-CHIP's scrolling and screen modes. */
+            return CHIP8_REF_UNSUPPORTED;
+        }
+        /* Anything else is SYS, ignored. */
+        break;
+
+    case 0x1:                               /* JP addr */
+        ref->PC = nnn;
+        return CHIP8_REF_OK;
+
+    case 0x2:                               /* CALL addr */
+        if (ref->SP + 1 >= CHIP8_TOTAL_STACK_DEPTH)
+            return CHIP8_REF_UNDEFINED;
+        ref->SP += 1;
+        ref->stack[ref->SP] = ref->PC + 2;
+        ref->PC = nnn;
+        return CHIP8_REF_OK;
+
+    case 0x3:                               /* SE Vx, byte */
+        return chip8_ref_skip(ref, V[x] == kk);
+
+    case 0x4:                               /* SNE Vx, byte */
+        return chip8_ref_skip(ref, V[x] != kk);
+
+    case 0x5:                               /* SE Vx, Vy */
+        if (n != 0)
+            return CHIP8_REF_UNSUPPORTED;
+        return chip8_ref_skip(ref, V[x] == V[y]);
+
+    case 0x6:                               /* LD Vx, byte */
+        V[x] = kk;
+        break;
+
+    case 0x7:                               /* ADD Vx, byte */
+        V[x] += kk;
+        break;
+
+    case 0x8:
+        switch (n)
+        {
+        case 0x0:                           /* LD Vx, Vy */
+            V[x] = V[y];
+            break;
+        case 0x1:                           /* OR Vx, Vy */
+            V[x] |= V[y];
+            break;
+        case 0x2:                           /* AND Vx, Vy */
+            V[x] &= V[y];
+            break;
+        case 0x3:                           /* XOR Vx, Vy */
+            V[x] ^= V[y];
+            break;
+        case 0x4:                           /* ADD Vx, Vy */
+        {
+            /* The flag is written after the result, so it wins for x = F. */
+            int sum = V[x] + V[y];
+            V[x] = sum;
+            V[0x0f] = sum > 0xff;
+            break;
+        }
+        case 0x5:                           /* SUB Vx, Vy */
+        {
+            int flag = V[x] >= V[y];
+            V[x] -= V[y];
+            V[0x0f] = flag;
+            break;
+        }
+        case 0x6:                           /* SHR Vx */
+        {
+            int flag = V[x] & 1;
+            V[x] /= 2;
+            V[0x0f] = flag;
+            break;
+        }
+        case 0x7:                           /* SUBN Vx, Vy */
+        {
+            int flag = V[y] >= V[x];
+            V[x] = V[y] - V[x];
+            V[0x0f] = flag;
+            break;
+        }
+        case 0xe:                           /* SHL Vx */
+        {
+            int flag = V[x] >> 7;
+            V[x] *= 2;
+            V[0x0f] = flag;
+            break;
+        }
+        default:
+            return CHIP8_REF_UNSUPPORTED;
+        }
+        break;
+
+    case 0x9:                               /* SNE Vx, Vy */
+        if (n != 0)
+            return CHIP8_REF_UNSUPPORTED;
+        return chip8_ref_skip(ref, V[x] != V[y]);
+
+    case 0xa:                               /* LD I, addr */
+        ref->I = nnn;
+        break;
+
+    case 0xb:                               /* JP V0, addr */
+        ref->PC = nnn + V[0];
+        return CHIP8_REF_OK;
+
+    case 0xc:                               /* RND Vx, byte */
+        V[x] = chip8_ref_random(ref) & kk;
+        break;
+
+    case 0xd:                               /* DRW Vx, Vy, nibble */
+        if (n == 0)
+            return CHIP8_REF_UNSUPPORTED;
+        if (!chip8_ref_in_memory(ref->I, n))
+            return CHIP8_REF_UNDEFINED;
+        chip8_ref_draw(ref, V[x], V[y], n);
+        break;
+
+    case 0xe:
+        if (kk == 0x9e)                     /* SKP Vx */
+            return chip8_ref_skip(ref, ref->keys[V[x] & 0x0f]);
+        if (kk == 0xa1)                     /* SKNP Vx */
+            return chip8_ref_skip(ref, !ref->keys[V[x] & 0x0f]);
+        return CHIP8_REF_UNSUPPORTED;
+
+    case 0xf:
+        switch (kk)
+        {
+        case 0x07:                          /* LD Vx, DT */
+            V[x] = ref->delay_timer;
+            break;
+        case 0x0a:                          /* LD Vx, K */
+        {
+            int key = 0;
+            while (key < CHIP8_TOTAL_KEYS && !ref->keys[key])
+                key++;
+            if (key == CHIP8_TOTAL_KEYS)
+                return CHIP8_REF_OK;        /* Wait, PC stays. */
+            V[x] = key;
+            break;
+        }
+        case 0x15:                          /* LD DT, Vx */
+            ref->delay_timer = V[x];
+            break;
+        case 0x18:                          /* LD ST, Vx */
+            ref->sound_timer = V[x];
+            break;
+        case 0x1e:                          /* ADD I, Vx */
+            ref->I += V[x];
+            break;
+        case 0x29:                          /* LD F, Vx */
+            ref->I = CHIP8_CHARACTER_SET_LOAD_ADDRESS +
+                     V[x] * CHIP8_DEFAULT_SPRITE_HEIGHT;
+            break;
+        case 0x33:                          /* LD B, Vx */
+            if (!chip8_ref_in_memory(ref->I, 3))
+                return CHIP8_REF_UNDEFINED;
+            ref->memory[ref->I] = V[x] / 100;
+            ref->memory[ref->I + 1] = V[x] / 10 % 10;
+            ref->memory[ref->I + 2] = V[x] % 10;
+            break;
+        case 0x55:                          /* LD [I], Vx */
+            if (!chip8_ref_in_memory(ref->I, x + 1))
+                return CHIP8_REF_UNDEFINED;
+            for (int i = 0; i <= x; ++i)
+            {
+                ref->memory[ref->I + i] = V[i];
+            }
+            break;
+        case 0x65:                          /* LD Vx, [I] */
+            if (!chip8_ref_in_memory(ref->I, x + 1))
+                return CHIP8_REF_UNDEFINED;
+            for (int i = 0; i <= x; ++i)
+            {
+                V[i] = ref->memory[ref->I + i];
+            }
+            break;
+        default:
+            return CHIP8_REF_UNSUPPORTED;
+        }
+        break;
+    }
+
+    ref->PC += 2;
+    return CHIP8_REF_OK;
+}
+
+void chip8_ref_tick(struct chip8_ref *ref)
+{
+    if (ref->delay_timer > 0)
+        ref->delay_timer -= 1;
+    if (ref->sound_timer > 0)
+        ref->sound_timer -= 1;
+}
+
+uint64_t chip8_ref_hash(const struct chip8_ref *ref)
+{
+    unsigned char display[CHIP8_HEIGHT * CHIP8_WIDTH];
+    for (int y = 0; y < CHIP8_HEIGHT; ++y)
+    {
+        for (int x = 0; x < CHIP8_WIDTH; ++x)
+        {
+            display[y * CHIP8_WIDTH + x] = ref->display[y][x];
+        }
+    }
+    unsigned short words[3 + CHIP8_TOTAL_STACK_DEPTH] =
+    {
+        ref->I, ref->PC, ref->SP | ref->delay_timer << 8
+    };
+    memcpy(&words[3], ref->stack, sizeof(ref->stack));
+    unsigned char bytes[CHIP8_TOTAL_DATA_REGISTERS + 1];
+    memcpy(bytes, ref->V, sizeof(ref->V));
+    bytes[CHIP8_TOTAL_DATA_REGISTERS] = ref->sound_timer;
+
+    uint64_t hash = chip8_hash(ref->memory, sizeof(ref->memory), 0);
+    hash = chip8_hash(display, sizeof(display), hash);
+    hash = chip8_hash(words, sizeof(words), hash);
+    hash = chip8_hash(bytes, sizeof(bytes), hash);
+    return chip8_hash(&ref->random, sizeof(ref->random), hash);
+}
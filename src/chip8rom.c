@@ -0,0 +1,285 @@
+#include "chip8rom.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CHIP8_ROM_ARCHIVE_MAGIC "C8PK"
+#define CHIP8_ROM_ARCHIVE_HEADER_SIZE 8
+#define CHIP8_ROM_ARCHIVE_ENTRY_SIZE (CHIP8_ROM_ARCHIVE_NAME_SIZE + 8)
+
+const char *chip8_rom_error_string(int error)
+{
+    switch (error)
+    {
+        case CHIP8_ROM_OK:              return "no error";
+        case CHIP8_ROM_ERROR_OPEN:      return "can't open the file";
+        case CHIP8_ROM_ERROR_EMPTY:     return "the ROM is empty";
+        case CHIP8_ROM_ERROR_TOO_LARGE: return "the ROM doesn't fit in memory";
+        case CHIP8_ROM_ERROR_ARCHIVE:   return "not a valid ROM archive";
+        case CHIP8_ROM_ERROR_NOT_FOUND: return "no such ROM in the archive";
+        case CHIP8_ROM_ERROR_WRITE:     return "can't write the file";
+    }
+    return "unknown error";
+}
+
+int chip8_rom_validate(size_t size)
+{
+    if (size == 0)
+        return CHIP8_ROM_ERROR_EMPTY;
+    if (size > CHIP8_MAX_PROGRAM_SIZE)
+        return CHIP8_ROM_ERROR_TOO_LARGE;
+    return CHIP8_ROM_OK;
+}
+
+/* Maps the whole file read-only. Files larger than "max_size" are refused 
+before mapping them. */
+static int chip8_rom_map(struct chip8_rom_file *file, const char *filename,
+                         unsigned long long max_size)
+{
+    memset(file, 0, sizeof(struct chip8_rom_file));
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return CHIP8_ROM_ERROR_OPEN;
+
+    LARGE_INTEGER size;
+    int res = CHIP8_ROM_OK;
+    if (!GetFileSizeEx(handle, &size))
+        res = CHIP8_ROM_ERROR_OPEN;
+    else if (size.QuadPart == 0)
+        res = CHIP8_ROM_ERROR_EMPTY;
+    else if ((unsigned long long)size.QuadPart > max_size)
+        res = CHIP8_ROM_ERROR_TOO_LARGE;
+    if (res != CHIP8_ROM_OK)
+    {
+        CloseHandle(handle);
+        return res;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, 
+                                        NULL);
+    CloseHandle(handle);
+    if (!mapping)
+        return CHIP8_ROM_ERROR_OPEN;
+
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data)
+    {
+        CloseHandle(mapping);
+        return CHIP8_ROM_ERROR_OPEN;
+    }
+    file->mapping = mapping;
+    file->size = size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return CHIP8_ROM_ERROR_OPEN;
+
+    struct stat st;
+    int res = CHIP8_ROM_OK;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        res = CHIP8_ROM_ERROR_OPEN;
+    else if (st.st_size == 0)
+        res = CHIP8_ROM_ERROR_EMPTY;
+    else if ((unsigned long long)st.st_size > max_size)
+        res = CHIP8_ROM_ERROR_TOO_LARGE;
+    if (res != CHIP8_ROM_OK)
+    {
+        close(fd);
+        return res;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return CHIP8_ROM_ERROR_OPEN;
+
+    file->data = data;
+    file->size = st.st_size;
+#endif
+    return CHIP8_ROM_OK;
+}
+
+static void chip8_rom_unmap(struct chip8_rom_file *file)
+{
+    if (!file->data)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+#else
+    munmap((void *)file->data, file->size);
+#endif
+    file->data = NULL;
+}
+
+int chip8_rom_open(struct chip8_rom_file *file, const char *filename, 
+                   struct chip8_rom *rom)
+{
+    int res = chip8_rom_map(file, filename, CHIP8_MAX_PROGRAM_SIZE);
+    if (res != CHIP8_ROM_OK)
+        return res;
+
+    rom->data = file->data;
+    rom->size = file->size;
+    return CHIP8_ROM_OK;
+}
+
+void chip8_rom_close(struct chip8_rom_file *file)
+{
+    chip8_rom_unmap(file);
+}
+
+static uint32_t chip8_rom_read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | 
+           (uint32_t)p[3] << 24;
+}
+
+static void chip8_rom_write32(unsigned char *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static const unsigned char *chip8_rom_archive_entry(
+    struct chip8_rom_archive *archive, uint32_t index)
+{
+    return archive->file.data + CHIP8_ROM_ARCHIVE_HEADER_SIZE + 
+           (size_t)index * CHIP8_ROM_ARCHIVE_ENTRY_SIZE;
+}
+
+int chip8_rom_archive_open(struct chip8_rom_archive *archive, 
+                           const char *filename)
+{
+    struct chip8_rom_file *file = &archive->file;
+    archive->count = 0;
+    int res = chip8_rom_map(file, filename, SIZE_MAX);
+    if (res != CHIP8_ROM_OK)
+        return res;
+
+    if (file->size < CHIP8_ROM_ARCHIVE_HEADER_SIZE || 
+        memcmp(file->data, CHIP8_ROM_ARCHIVE_MAGIC, 4) != 0)
+    {
+        chip8_rom_unmap(file);
+        return CHIP8_ROM_ERROR_ARCHIVE;
+    }
+
+    uint32_t count = chip8_rom_read32(file->data + 4);
+    size_t space = file->size - CHIP8_ROM_ARCHIVE_HEADER_SIZE;
+    if (count > space / CHIP8_ROM_ARCHIVE_ENTRY_SIZE)
+    {
+        chip8_rom_unmap(file);
+        return CHIP8_ROM_ERROR_ARCHIVE;
+    }
+    archive->count = count;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const unsigned char *entry = chip8_rom_archive_entry(archive, i);
+        uint64_t offset = chip8_rom_read32(entry + CHIP8_ROM_ARCHIVE_NAME_SIZE);
+        uint64_t size = chip8_rom_read32(entry + CHIP8_ROM_ARCHIVE_NAME_SIZE + 
+                                         4);
+        if (!memchr(entry, 0, CHIP8_ROM_ARCHIVE_NAME_SIZE) || 
+            offset + size > file->size || 
+            chip8_rom_validate(size) != CHIP8_ROM_OK)
+        {
+            chip8_rom_archive_close(archive);
+            return CHIP8_ROM_ERROR_ARCHIVE;
+        }
+    }
+    return CHIP8_ROM_OK;
+}
+
+const char *chip8_rom_archive_get(struct chip8_rom_archive *archive, 
+                                  uint32_t index, struct chip8_rom *rom)
+{
+    if (index >= archive->count)
+        return NULL;
+
+    const unsigned char *entry = chip8_rom_archive_entry(archive, index);
+    rom->data = archive->file.data + 
+                chip8_rom_read32(entry + CHIP8_ROM_ARCHIVE_NAME_SIZE);
+    rom->size = chip8_rom_read32(entry + CHIP8_ROM_ARCHIVE_NAME_SIZE + 4);
+    return (const char *)entry;
+}
+
+int chip8_rom_archive_find(struct chip8_rom_archive *archive, 
+                           const char *name, struct chip8_rom *rom)
+{
+    for (uint32_t i = 0; i < archive->count; ++i)
+    {
+        struct chip8_rom candidate;
+        if (strcmp(chip8_rom_archive_get(archive, i, &candidate), name) == 0)
+        {
+            *rom = candidate;
+            return CHIP8_ROM_OK;
+        }
+    }
+    return CHIP8_ROM_ERROR_NOT_FOUND;
+}
+
+void chip8_rom_archive_close(struct chip8_rom_archive *archive)
+{
+    chip8_rom_unmap(&archive->file);
+    archive->count = 0;
+}
+
+int chip8_rom_archive_write(const char *filename, const char *const *names,
+                            const struct chip8_rom *roms, uint32_t count)
+{
+    FILE *f = fopen(filename, "wb");
+    if (!f)
+        return CHIP8_ROM_ERROR_WRITE;
+
+    unsigned char header[CHIP8_ROM_ARCHIVE_HEADER_SIZE];
+    memcpy(header, CHIP8_ROM_ARCHIVE_MAGIC, 4);
+    chip8_rom_write32(header + 4, count);
+    int res = fwrite(header, sizeof(header), 1, f) == 1 ? 
+              CHIP8_ROM_OK : CHIP8_ROM_ERROR_WRITE;
+
+    uint64_t offset = CHIP8_ROM_ARCHIVE_HEADER_SIZE + 
+                      (uint64_t)count * CHIP8_ROM_ARCHIVE_ENTRY_SIZE;
+    for (uint32_t i = 0; i < count && res == CHIP8_ROM_OK; ++i)
+    {
+        unsigned char entry[CHIP8_ROM_ARCHIVE_ENTRY_SIZE] = {0};
+        if (strlen(names[i]) >= CHIP8_ROM_ARCHIVE_NAME_SIZE || 
+            offset + roms[i].size > UINT32_MAX)
+            res = CHIP8_ROM_ERROR_ARCHIVE;
+        else if (chip8_rom_validate(roms[i].size) != CHIP8_ROM_OK)
+            res = chip8_rom_validate(roms[i].size);
+        if (res != CHIP8_ROM_OK)
+            break;
+
+        strcpy((char *)entry, names[i]);
+        chip8_rom_write32(entry + CHIP8_ROM_ARCHIVE_NAME_SIZE, offset);
+        chip8_rom_write32(entry + CHIP8_ROM_ARCHIVE_NAME_SIZE + 4, 
+                          roms[i].size);
+        if (fwrite(entry, sizeof(entry), 1, f) != 1)
+            res = CHIP8_ROM_ERROR_WRITE;
+        offset += roms[i].size;
+    }
+
+    for (uint32_t i = 0; i < count && res == CHIP8_ROM_OK; ++i)
+    {
+        if (fwrite(roms[i].data, roms[i].size, 1, f) != 1)
+            res = CHIP8_ROM_ERROR_WRITE;
+    }
+
+    if (fclose(f) != 0 && res == CHIP8_ROM_OK)
+        res = CHIP8_ROM_ERROR_WRITE;
+    if (res != CHIP8_ROM_OK)
+        remove(filename);
+    return res;
+}
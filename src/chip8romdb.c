@@ -0,0 +1,145 @@
+#include "chip8romdb.h"
+#include "chip8quirks.h"
+#include <stdio.h>
+#include <string.h>
+
+/* The COSMAC VIP keypad laid over the left of a QWERTY keyboard, as "1234", 
+"qwer", "asdf" and "zxcv", indexed by Chip-8 key. */
+#define CHIP8_ROMDB_KEYPAD_MAP "x123qweasdzc4rfv"
+
+/* Sorted by hash. */
+static const struct chip8_romdb_entry chip8_romdb_builtin[] =
+{
+    { 0x04068f4deafe8b10ULL, "INVADERS", CHIP8_PROFILE_DEFAULT, 15, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+    { 0x20c1eca6aba1aa91ULL, "TICTAC",   CHIP8_PROFILE_DEFAULT, 10, NULL },
+    { 0x2f50095261d7c24dULL, "BRIX",     CHIP8_PROFILE_DEFAULT, 10, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+    { 0x42bdaf39c631566eULL, "KALEID",   CHIP8_PROFILE_DEFAULT, 10, NULL },
+    { 0x47e1744327ff56a4ULL, "MISSILE",  CHIP8_PROFILE_DEFAULT, 10, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+    { 0x54024a6a6b0b3ce1ULL, "TANK",     CHIP8_PROFILE_DEFAULT, 10, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+    { 0x85652bcc92e412c0ULL, "PONG",     CHIP8_PROFILE_DEFAULT, 7, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+    { 0x8c9a5f6a465850f8ULL, "UFO",      CHIP8_PROFILE_DEFAULT, 10, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+    { 0xc46ca389cecf0734ULL, "15PUZZLE", CHIP8_PROFILE_DEFAULT, 10, NULL },
+    { 0xe9322020b823e5a7ULL, "BLINKY",   CHIP8_PROFILE_DEFAULT, 15, 
+      CHIP8_ROMDB_KEYPAD_MAP },
+};
+
+#define CHIP8_ROMDB_TOTAL_BUILTIN \
+    (sizeof(chip8_romdb_builtin) / sizeof(chip8_romdb_builtin[0]))
+
+struct chip8_romdb_override
+{
+    struct chip8_romdb_entry entry;
+    char keyboard_map[CHIP8_TOTAL_KEYS];
+};
+
+static struct chip8_romdb_override 
+    chip8_romdb_overrides[CHIP8_ROMDB_MAX_OVERRIDES];
+static int chip8_romdb_override_count = 0;
+
+const struct chip8_romdb_entry *chip8_romdb_find(uint64_t hash)
+{
+    /* The most recently loaded override wins. */
+    for (int i = chip8_romdb_override_count - 1; i >= 0; --i)
+    {
+        if (chip8_romdb_overrides[i].entry.hash == hash)
+            return &chip8_romdb_overrides[i].entry;
+    }
+
+    size_t low = 0;
+    size_t high = CHIP8_ROMDB_TOTAL_BUILTIN;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (chip8_romdb_builtin[mid].hash < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < CHIP8_ROMDB_TOTAL_BUILTIN && 
+        chip8_romdb_builtin[low].hash == hash)
+        return &chip8_romdb_builtin[low];
+    return NULL;
+}
+
+/* Parses one line of the override file. Returns 1 for an entry, 0 for a 
+blank or comment line and -1 when invalid. */
+static int chip8_romdb_parse_line(const char *line, 
+                                  struct chip8_romdb_override *override)
+{
+    unsigned long long hash;
+    char profile[16];
+    unsigned int ipf;
+    char map[CHIP8_TOTAL_KEYS + 2] = "-";
+    char extra[2];
+
+    while (*line == ' ' || *line == '\t')
+        line++;
+    if (*line == '#' || *line == '\n' || *line == '\r' || *line == '\0')
+        return 0;
+
+    int n = sscanf(line, "%llx %15s %u %17s %1s", &hash, profile, &ipf, map,
+                   extra);
+    if (n < 3 || n > 4 || ipf == 0 || ipf > 0xffff)
+        return -1;
+
+    int quirks = chip8_quirks_parse(profile);
+    if (quirks < 0)
+        return -1;
+
+    memset(override, 0, sizeof(struct chip8_romdb_override));
+    override->entry.hash = hash;
+    override->entry.quirks = quirks;
+    override->entry.instructions_per_frame = ipf;
+    if (strcmp(map, "-") != 0)
+    {
+        if (strlen(map) != CHIP8_TOTAL_KEYS)
+            return -1;
+        memcpy(override->keyboard_map, map, CHIP8_TOTAL_KEYS);
+        override->entry.keyboard_map = override->keyboard_map;
+    }
+    return 1;
+}
+
+int chip8_romdb_load_overrides(const char *filename)
+{
+    FILE *f = fopen(filename, "r");
+    if (!f)
+        return -1;
+
+    int count = chip8_romdb_override_count;
+    char line[256];
+    int res = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        /* Blank and comment lines don't need room, so the table is only 
+        checked for entries. */
+        struct chip8_romdb_override parsed;
+        int n = chip8_romdb_parse_line(line, &parsed);
+        if (n < 0 || (n > 0 && count == CHIP8_ROMDB_MAX_OVERRIDES))
+        {
+            res = -1;
+            break;
+        }
+        if (n > 0)
+        {
+            struct chip8_romdb_override *override = 
+                &chip8_romdb_overrides[count++];
+            *override = parsed;
+            /* The map points into the override, so it follows the copy. */
+            if (parsed.entry.keyboard_map)
+                override->entry.keyboard_map = override->keyboard_map;
+        }
+    }
+    fclose(f);
+
+    /* Lines are only committed when the whole file is valid. */
+    if (res == 0)
+        chip8_romdb_override_count = count;
+    return res;
+}
@@ -0,0 +1,318 @@
+#include "chip8scale.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* The largest image filtered: a low resolution screen after Scale3x. */
+#define MAX_SOURCE_WIDTH (CHIP8_WIDTH * 3)
+#define MAX_SOURCE_HEIGHT (CHIP8_HEIGHT * 3)
+
+/* Images to filter are copied with a border of one pixel repeating the
+edge, so every pixel has eight neighbours. */
+#define PADDED_SIZE ((MAX_SOURCE_WIDTH + 2) * (MAX_SOURCE_HEIGHT + 2))
+
+int chip8_scale_parse(const char *name)
+{
+    if (strcmp(name, "none") == 0)
+        return CHIP8_SCALE_NONE;
+    if (strcmp(name, "scale2x") == 0)
+        return CHIP8_SCALE_2X;
+    if (strcmp(name, "scale3x") == 0)
+        return CHIP8_SCALE_3X;
+    return -1;
+}
+
+int chip8_scale_factor(enum chip8_scale_filter filter)
+{
+    switch (filter)
+    {
+    case CHIP8_SCALE_2X:
+        return 2;
+    case CHIP8_SCALE_3X:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+/* Writes the colours of the screen at its own resolution into "image". */
+static void chip8_scale_unpack(const struct chip8_screen *screen,
+                               unsigned char *image, int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int shift = 63 - x % 64;
+            int color = 0;
+            for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+            {
+                color |= ((screen->rows[plane][y][x / 64] >> shift) & 1)
+                         << plane;
+            }
+            *image++ = color;
+        }
+    }
+}
+
+static void chip8_scale_pad(const unsigned char *image, int width,
+                            int height, unsigned char *padded)
+{
+    int stride = width + 2;
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char *row = padded + (y + 1) * stride;
+        memcpy(row + 1, image + y * width, width);
+        row[0] = row[1];
+        row[width + 1] = row[width];
+    }
+    memcpy(padded, padded + stride, stride);
+    memcpy(padded + (height + 1) * stride, padded + height * stride, stride);
+}
+
+/*
+In both filters, with the neighbours of pixel E named
+
+    A B C
+    D E F
+    G H I
+
+the corner of E next to B and D takes their colour when they are equal and
+the other two neighbours on that side, F and H, differ from them. The
+other corners are the same turned around.
+*/
+
+static void chip8_scale2x(const unsigned char *image, int width, int height,
+                          unsigned char *scaled)
+{
+    unsigned char padded[PADDED_SIZE];
+    chip8_scale_pad(image, width, height, padded);
+
+    int stride = width + 2;
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char *middle = padded + (y + 1) * stride + 1;
+        const unsigned char *above = middle - stride;
+        const unsigned char *below = middle + stride;
+        unsigned char *top = scaled + 2 * y * 2 * width;
+        unsigned char *bottom = top + 2 * width;
+
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i b = _mm_loadu_si128((const __m128i *)(above + x));
+            __m128i d = _mm_loadu_si128((const __m128i *)(middle + x - 1));
+            __m128i e = _mm_loadu_si128((const __m128i *)(middle + x));
+            __m128i f = _mm_loadu_si128((const __m128i *)(middle + x + 1));
+            __m128i h = _mm_loadu_si128((const __m128i *)(below + x));
+
+            __m128i db = _mm_cmpeq_epi8(d, b);
+            __m128i bf = _mm_cmpeq_epi8(b, f);
+            __m128i dh = _mm_cmpeq_epi8(d, h);
+            __m128i hf = _mm_cmpeq_epi8(h, f);
+
+            /* All ones where the corner takes the neighbour's colour. */
+            __m128i c0 = _mm_andnot_si128(_mm_or_si128(bf, dh), db);
+            __m128i c1 = _mm_andnot_si128(_mm_or_si128(db, hf), bf);
+            __m128i c2 = _mm_andnot_si128(_mm_or_si128(db, hf), dh);
+            __m128i c3 = _mm_andnot_si128(_mm_or_si128(dh, bf), hf);
+
+            __m128i e0 = _mm_or_si128(_mm_and_si128(c0, d),
+                                      _mm_andnot_si128(c0, e));
+            __m128i e1 = _mm_or_si128(_mm_and_si128(c1, f),
+                                      _mm_andnot_si128(c1, e));
+            __m128i e2 = _mm_or_si128(_mm_and_si128(c2, d),
+                                      _mm_andnot_si128(c2, e));
+            __m128i e3 = _mm_or_si128(_mm_and_si128(c3, f),
+                                      _mm_andnot_si128(c3, e));
+
+            __m128i *out = (__m128i *)(top + 2 * x);
+            _mm_storeu_si128(out, _mm_unpacklo_epi8(e0, e1));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(e0, e1));
+            out = (__m128i *)(bottom + 2 * x);
+            _mm_storeu_si128(out, _mm_unpacklo_epi8(e2, e3));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(e2, e3));
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            int b = above[x], d = middle[x - 1], e = middle[x];
+            int f = middle[x + 1], h = below[x];
+            top[2 * x] = d == b && b != f && d != h ? d : e;
+            top[2 * x + 1] = b == f && b != d && f != h ? f : e;
+            bottom[2 * x] = d == h && d != b && h != f ? d : e;
+            bottom[2 * x + 1] = h == f && d != h && b != f ? f : e;
+        }
+    }
+}
+
+/* Scale3x also fills the middle of each side, from the neighbour on that
+side when one corner next to it is filled and E differs from the far
+corner. */
+static void chip8_scale3x(const unsigned char *image, int width, int height,
+                          unsigned char *scaled)
+{
+    unsigned char padded[PADDED_SIZE];
+    chip8_scale_pad(image, width, height, padded);
+
+    int stride = width + 2;
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char *middle = padded + (y + 1) * stride + 1;
+        const unsigned char *above = middle - stride;
+        const unsigned char *below = middle + stride;
+        unsigned char *out[3];
+        out[0] = scaled + 3 * y * 3 * width;
+        out[1] = out[0] + 3 * width;
+        out[2] = out[1] + 3 * width;
+
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(above + x - 1));
+            __m128i b = _mm_loadu_si128((const __m128i *)(above + x));
+            __m128i c = _mm_loadu_si128((const __m128i *)(above + x + 1));
+            __m128i d = _mm_loadu_si128((const __m128i *)(middle + x - 1));
+            __m128i e = _mm_loadu_si128((const __m128i *)(middle + x));
+            __m128i f = _mm_loadu_si128((const __m128i *)(middle + x + 1));
+            __m128i g = _mm_loadu_si128((const __m128i *)(below + x - 1));
+            __m128i h = _mm_loadu_si128((const __m128i *)(below + x));
+            __m128i i = _mm_loadu_si128((const __m128i *)(below + x + 1));
+
+            __m128i db = _mm_cmpeq_epi8(d, b);
+            __m128i bf = _mm_cmpeq_epi8(b, f);
+            __m128i dh = _mm_cmpeq_epi8(d, h);
+            __m128i hf = _mm_cmpeq_epi8(h, f);
+            __m128i ea = _mm_cmpeq_epi8(e, a);
+            __m128i ec = _mm_cmpeq_epi8(e, c);
+            __m128i eg = _mm_cmpeq_epi8(e, g);
+            __m128i ei = _mm_cmpeq_epi8(e, i);
+
+            /* The corners next to B and D, B and F, D and H, H and F. */
+            __m128i c0 = _mm_andnot_si128(_mm_or_si128(bf, dh), db);
+            __m128i c2 = _mm_andnot_si128(_mm_or_si128(db, hf), bf);
+            __m128i c6 = _mm_andnot_si128(_mm_or_si128(db, hf), dh);
+            __m128i c8 = _mm_andnot_si128(_mm_or_si128(dh, bf), hf);
+
+            __m128i c1 = _mm_or_si128(_mm_andnot_si128(ec, c0),
+                                      _mm_andnot_si128(ea, c2));
+            __m128i c3 = _mm_or_si128(_mm_andnot_si128(eg, c0),
+                                      _mm_andnot_si128(ea, c6));
+            __m128i c5 = _mm_or_si128(_mm_andnot_si128(ei, c2),
+                                      _mm_andnot_si128(ec, c8));
+            __m128i c7 = _mm_or_si128(_mm_andnot_si128(ei, c6),
+                                      _mm_andnot_si128(eg, c8));
+
+            __m128i sources[9] = { d, b, f, d, e, f, d, h, f };
+            __m128i conditions[9] = { c0, c1, c2, c3, _mm_setzero_si128(),
+                                      c5, c6, c7, c8 };
+            unsigned char blocks[9][16];
+            for (int n = 0; n < 9; ++n)
+            {
+                __m128i block = _mm_or_si128(
+                    _mm_and_si128(conditions[n], sources[n]),
+                    _mm_andnot_si128(conditions[n], e));
+                _mm_storeu_si128((__m128i *)blocks[n], block);
+            }
+
+            /* SSE2 can't shuffle bytes, so the three columns are
+            interleaved one by one. */
+            for (int row = 0; row < 3; ++row)
+            {
+                unsigned char *p = out[row] + 3 * x;
+                for (int n = 0; n < 16; ++n)
+                {
+                    *p++ = blocks[3 * row][n];
+                    *p++ = blocks[3 * row + 1][n];
+                    *p++ = blocks[3 * row + 2][n];
+                }
+            }
+        }
+#endif
+        for (; x < width; ++x)
+        {
+            int a = above[x - 1], b = above[x], c = above[x + 1];
+            int d = middle[x - 1], e = middle[x], f = middle[x + 1];
+            int g = below[x - 1], h = below[x], i = below[x + 1];
+            bool c0 = d == b && b != f && d != h;
+            bool c2 = b == f && b != d && f != h;
+            bool c6 = d == h && d != b && h != f;
+            bool c8 = h == f && d != h && b != f;
+
+            unsigned char *p = out[0] + 3 * x;
+            p[0] = c0 ? d : e;
+            p[1] = (c0 && e != c) || (c2 && e != a) ? b : e;
+            p[2] = c2 ? f : e;
+            p = out[1] + 3 * x;
+            p[0] = (c0 && e != g) || (c6 && e != a) ? d : e;
+            p[1] = e;
+            p[2] = (c2 && e != i) || (c8 && e != c) ? f : e;
+            p = out[2] + 3 * x;
+            p[0] = c6 ? d : e;
+            p[1] = (c6 && e != i) || (c8 && e != g) ? h : e;
+            p[2] = c8 ? f : e;
+        }
+    }
+}
+
+/* Enlarges by "factor" without filtering. */
+static void chip8_scale_blocks(const unsigned char *image, int width,
+                               int height, int factor, unsigned char *scaled)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char *row = scaled + y * factor * width * factor;
+        for (int x = 0; x < width; ++x)
+        {
+            memset(row + x * factor, image[y * width + x], factor);
+        }
+        for (int n = 1; n < factor; ++n)
+        {
+            memcpy(row + n * width * factor, row, width * factor);
+        }
+    }
+}
+
+void chip8_scale_render(enum chip8_scale_filter filter,
+                        const struct chip8_screen *screen,
+                        unsigned char *image)
+{
+    unsigned char source[CHIP8_HIRES_WIDTH * CHIP8_HIRES_HEIGHT];
+    unsigned char between[MAX_SOURCE_WIDTH * MAX_SOURCE_HEIGHT];
+    int width = screen->hires ? CHIP8_HIRES_WIDTH : CHIP8_WIDTH;
+    int height = screen->hires ? CHIP8_HIRES_HEIGHT : CHIP8_HEIGHT;
+    chip8_scale_unpack(screen, source, width, height);
+
+    switch (filter)
+    {
+    case CHIP8_SCALE_2X:
+        if (screen->hires)
+        {
+            chip8_scale2x(source, width, height, image);
+        }
+        else
+        {
+            chip8_scale2x(source, width, height, between);
+            chip8_scale2x(between, width * 2, height * 2, image);
+        }
+        break;
+    case CHIP8_SCALE_3X:
+        if (screen->hires)
+        {
+            chip8_scale3x(source, width, height, image);
+        }
+        else
+        {
+            chip8_scale3x(source, width, height, between);
+            chip8_scale2x(between, width * 3, height * 3, image);
+        }
+        break;
+    default:
+        chip8_scale_blocks(source, width, height, screen->hires ? 1 : 2,
+                           image);
+        break;
+    }
+}
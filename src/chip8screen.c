@@ -1,50 +1,310 @@
 #include "chip8screen.h"
+#include "chip8hash.h"
 #include <assert.h>
 #include <memory.h>
 
-static void chip8_screen_check_bounds(int x, int y)
+int chip8_screen_width(struct chip8_screen *screen)
 {
-    assert(x >= 0 && x < CHIP8_WIDTH && y >= 0 && y < CHIP8_HEIGHT);
+    return screen->hires ? CHIP8_HIRES_WIDTH : CHIP8_WIDTH;
+}
+
+int chip8_screen_height(struct chip8_screen *screen)
+{
+    return screen->hires ? CHIP8_HIRES_HEIGHT : CHIP8_HEIGHT;
+}
+
+static void chip8_screen_check_bounds(struct chip8_screen *screen, int x, int y)
+{
+    assert(x >= 0 && x < chip8_screen_width(screen) &&
+           y >= 0 && y < chip8_screen_height(screen));
+}
+
+static uint64_t chip8_screen_bit(int x)
+{
+    return (uint64_t)1 << (63 - x % 64);
+}
+
+static bool chip8_screen_plane_selected(struct chip8_screen *screen, 
+                                        int plane)
+{
+    return (screen->planes & (1 << plane)) != 0;
+}
+
+#ifdef CHIP8_INCREMENTAL_HASH
+/* The index of "word" in "rows", its position for chip8_zobrist. */
+static uint64_t chip8_screen_position(struct chip8_screen *screen, 
+                                      const uint64_t *word)
+{
+    return word - &screen->rows[0][0][0];
+}
+
+void chip8_screen_rehash(struct chip8_screen *screen)
+{
+    const uint64_t *words = &screen->rows[0][0][0];
+    int count = sizeof(screen->rows) / sizeof(uint64_t);
+    screen->hash = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        screen->hash ^= chip8_zobrist(i, words[i]);
+    }
+}
+
+/* XORs "bits" into "word", keeping the hash. */
+static void chip8_screen_xor_word(struct chip8_screen *screen, uint64_t *word,
+                                  uint64_t bits)
+{
+    uint64_t position = chip8_screen_position(screen, word);
+    screen->hash ^= chip8_zobrist(position, *word) ^ 
+                    chip8_zobrist(position, *word ^ bits);
+    *word ^= bits;
+}
+#define CHIP8_SCREEN_CHANGED(screen) chip8_screen_rehash(screen)
+#else
+static void chip8_screen_xor_word(struct chip8_screen *screen, uint64_t *word,
+                                  uint64_t bits)
+{
+    (void)screen;
+    *word ^= bits;
+}
+#define CHIP8_SCREEN_CHANGED(screen) ((void)(screen))
+#endif
+
+void chip8_screen_init(struct chip8_screen *screen)
+{
+    memset(screen, 0, sizeof(struct chip8_screen));
+    screen->planes = 1;
 }
 
 void chip8_screen_set(struct chip8_screen *screen, int x, int y)
 {
-    chip8_screen_check_bounds(x, y);
-    screen->pixels[y][x] = true;
+    chip8_screen_check_bounds(screen, x, y);
+    for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+    {
+        if (chip8_screen_plane_selected(screen, plane))
+            screen->rows[plane][y][x / 64] |= chip8_screen_bit(x);
+    }
+    CHIP8_SCREEN_CHANGED(screen);
 }
 
 void chip8_screen_clear(struct chip8_screen *screen)
 {
-    memset(screen->pixels, 0, sizeof(screen->pixels));
+    for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+    {
+        if (chip8_screen_plane_selected(screen, plane))
+            memset(screen->rows[plane], 0, sizeof(screen->rows[plane]));
+    }
+    CHIP8_SCREEN_CHANGED(screen);
+}
+
+int chip8_screen_get(struct chip8_screen *screen, int x, int y)
+{
+    chip8_screen_check_bounds(screen, x, y);
+    int color = 0;
+    for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+    {
+        if (screen->rows[plane][y][x / 64] & chip8_screen_bit(x))
+            color |= 1 << plane;
+    }
+    return color;
 }
 
 bool chip8_screen_is_set(struct chip8_screen *screen, int x, int y)
 {
-    chip8_screen_check_bounds(x, y);
-    return screen->pixels[y][x];
+    return chip8_screen_get(screen, x, y) != 0;
 }
 
-bool chip8_screen_draw_sprite(struct chip8_screen *screen, int x, int y,
-                              const char *sprite, int num)
+void chip8_screen_select_planes(struct chip8_screen *screen, int planes)
+{
+    screen->planes = planes & ((1 << CHIP8_TOTAL_PLANES) - 1);
+}
+
+void chip8_screen_set_hires(struct chip8_screen *screen, bool hires)
+{
+    /* Switching resolution clears every plane, not just the selected ones. */
+    screen->hires = hires;
+    memset(screen->rows, 0, sizeof(screen->rows));
+    CHIP8_SCREEN_CHANGED(screen);
+}
+
+/* XORs "bits", a sprite row aligned to the most significant bit, into row y
+starting at column x. Pixels past the right edge wrap around to the left.
+Returns true when a set pixel was erased. */
+static bool chip8_screen_xor_row(struct chip8_screen *screen, int plane, 
+                                 int x, int y, uint64_t bits)
+{
+    uint64_t *row = screen->rows[plane][y];
+    if (!screen->hires)
+    {
+        x %= CHIP8_WIDTH;
+        uint64_t mask = x ? (bits >> x) | (bits << (64 - x)) : bits;
+        bool collision = (row[0] & mask) != 0;
+        chip8_screen_xor_word(screen, &row[0], mask);
+        return collision;
+    }
+
+    /* Rotate the 128-bit value (hi, lo) right by x. */
+    x %= CHIP8_HIRES_WIDTH;
+    uint64_t hi = bits;
+    uint64_t lo = 0;
+    if (x >= 64)
+    {
+        lo = hi;
+        hi = 0;
+        x -= 64;
+    }
+    if (x)
+    {
+        uint64_t carry = hi << (64 - x);
+        hi = (hi >> x) | (lo << (64 - x));
+        lo = (lo >> x) | carry;
+    }
+
+    bool collision = ((row[0] & hi) | (row[1] & lo)) != 0;
+    chip8_screen_xor_word(screen, &row[0], hi);
+    chip8_screen_xor_word(screen, &row[1], lo);
+    return collision;
+}
+
+/* Draws "num" rows of "row_bytes" bytes into each selected plane. The data 
+for the second selected plane follows the data of the first. */
+static bool chip8_screen_draw(struct chip8_screen *screen, int x, int y,
+                              const char *sprite, int num, int row_bytes)
 {
     bool pixel_collision = false;
-    
-    for (int ly = 0; ly < num; ++ly)
+    int height = chip8_screen_height(screen);
+
+    for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
     {
-        char c = sprite[ly];
-        for (int lx = 0; lx < 8; ++lx)
+        if (!chip8_screen_plane_selected(screen, plane))
+            continue;
+
+        for (int ly = 0; ly < num; ++ly)
         {
-            /* If the colored bit is zero, then no pixel is set. */
-            if ((c & (0b10000000 >> lx)) == 0)
-                continue;
-
-            if (screen->pixels[(ly+y) % CHIP8_HEIGHT][(lx+x) % CHIP8_WIDTH])
-            {
-                pixel_collision = true;
-            }
+            uint64_t bits = (uint64_t)(unsigned char)sprite[0] << 56;
+            if (row_bytes == 2)
+                bits |= (uint64_t)(unsigned char)sprite[1] << 48;
+            sprite += row_bytes;
+
             /* wrap around; don't need to check whether it's in bounds */
-            screen->pixels[(ly+y)%CHIP8_HEIGHT][(lx+x)%CHIP8_WIDTH] ^= true;
+            pixel_collision |= chip8_screen_xor_row(screen, plane, x, 
+                                                    (ly + y) % height, bits);
+        }
+    }
+    return pixel_collision;
+}
+
+bool chip8_screen_draw_sprite(struct chip8_screen *screen, int x, int y,
+                              const char *sprite, int num)
+{
+    return chip8_screen_draw(screen, x, y, sprite, num, 1);
+}
+
+bool chip8_screen_draw_sprite16(struct chip8_screen *screen, int x, int y,
+                                const char *sprite)
+{
+    return chip8_screen_draw(screen, x, y, sprite, 16, 2);
+}
+
+void chip8_screen_scroll_down(struct chip8_screen *screen, int num)
+{
+    int height = chip8_screen_height(screen);
+    if (num > height)
+        num = height;
+
+    for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+    {
+        if (!chip8_screen_plane_selected(screen, plane))
+            continue;
+
+        uint64_t (*rows)[CHIP8_SCREEN_ROW_WORDS] = screen->rows[plane];
+        memmove(rows[num], rows[0], (height - num) * sizeof(rows[0]));
+        memset(rows[0], 0, num * sizeof(rows[0]));
+    }
+    CHIP8_SCREEN_CHANGED(screen);
+}
+
+void chip8_screen_scroll_up(struct chip8_screen *screen, int num)
+{
+    int height = chip8_screen_height(screen);
+    if (num > height)
+        num = height;
+
+    for (int plane = 0; plane < CHIP8_TOTAL_PLANES; ++plane)
+    {
+        if (!chip8_screen_plane_selected(screen, plane))
+            continue;
+
+        uint64_t (*rows)[CHIP8_SCREEN_ROW_WORDS] = screen->rows[plane];
+        memmove(rows[0], rows[num], (height - num) * sizeof(rows[0]));
+        memset(rows[height - num], 0, num * sizeof(rows[0]));
+    }
+    CHIP8_SCREEN_CHANGED(screen);
+}
+
+void chip8_screen_scroll_right(struct chip8_screen *screen, int num)
+{
+    int height = chip8_screen_height(screen);
+    if (num >= chip8_screen_width(screen))
+    {
+        chip8_screen_clear(screen);
+        return;
+    }
+
+    for (int i = 0; i < CHIP8_TOTAL_PLANES * height && num > 0; ++i)
+    {
+        int plane = i / height;
+        if (!chip8_screen_plane_selected(screen, plane))
+            continue;
+
+        uint64_t *row = screen->rows[plane][i % height];
+        if (!screen->hires)
+        {
+            row[0] >>= num;
+        }
+        else if (num >= 64)
+        {
+            row[1] = row[0] >> (num - 64);
+            row[0] = 0;
+        }
+        else
+        {
+            row[1] = (row[1] >> num) | (row[0] << (64 - num));
+            row[0] >>= num;
+        }
+    }
+    CHIP8_SCREEN_CHANGED(screen);
+}
+
+void chip8_screen_scroll_left(struct chip8_screen *screen, int num)
+{
+    int height = chip8_screen_height(screen);
+    if (num >= chip8_screen_width(screen))
+    {
+        chip8_screen_clear(screen);
+        return;
+    }
+
+    for (int i = 0; i < CHIP8_TOTAL_PLANES * height && num > 0; ++i)
+    {
+        int plane = i / height;
+        if (!chip8_screen_plane_selected(screen, plane))
+            continue;
+
+        uint64_t *row = screen->rows[plane][i % height];
+        if (!screen->hires)
+        {
+            row[0] <<= num;
+        }
+        else if (num >= 64)
+        {
+            row[0] = row[1] << (num - 64);
+            row[1] = 0;
+        }
+        else
+        {
+            row[0] = (row[0] << num) | (row[1] >> (64 - num));
+            row[1] <<= num;
         }
-    }    
-    return pixel_collision;    
+    }
+    CHIP8_SCREEN_CHANGED(screen);
 }
@@ -0,0 +1,95 @@
+#include "chip8script.h"
+#include <stdlib.h>
+#include <string.h>
+
+int chip8_script_load(struct chip8_script *script, const char *filename)
+{
+    memset(script, 0, sizeof(struct chip8_script));
+    FILE *file = fopen(filename, "r");
+    if (!file)
+        return -1;
+
+    int capacity = 0;
+    int res = 0;
+    char line[128];
+    while (res == 0 && fgets(line, sizeof(line), file))
+    {
+        unsigned long frame;
+        unsigned int keys;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+        if (sscanf(line, "%lu %x", &frame, &keys) != 2 || keys > 0xffff ||
+            (script->count > 0 &&
+             frame <= script->entries[script->count - 1].frame))
+        {
+            res = -1;
+            break;
+        }
+
+        if (script->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            struct chip8_script_entry *entries = realloc(script->entries,
+                capacity * sizeof(struct chip8_script_entry));
+            if (!entries)
+            {
+                res = -1;
+                break;
+            }
+            script->entries = entries;
+        }
+        script->entries[script->count].frame = frame;
+        script->entries[script->count].keys = keys;
+        script->count++;
+    }
+    fclose(file);
+
+    if (res != 0)
+        chip8_script_free(script);
+    return res;
+}
+
+uint16_t chip8_script_keys(struct chip8_script *script, unsigned long frame)
+{
+    while (script->next < script->count &&
+           script->entries[script->next].frame <= frame)
+    {
+        script->keys = script->entries[script->next].keys;
+        script->next++;
+    }
+    return script->keys;
+}
+
+void chip8_script_free(struct chip8_script *script)
+{
+    free(script->entries);
+    memset(script, 0, sizeof(struct chip8_script));
+}
+
+int chip8_script_create(struct chip8_script_writer *writer,
+                        const char *filename)
+{
+    memset(writer, 0, sizeof(struct chip8_script_writer));
+    writer->file = fopen(filename, "w");
+    return writer->file ? 0 : -1;
+}
+
+void chip8_script_write(struct chip8_script_writer *writer,
+                        unsigned long frame, uint16_t keys)
+{
+    /* Nothing is down before the first line, so it can wait for a key. */
+    if (writer->started ? keys == writer->keys : keys == 0)
+        return;
+    fprintf(writer->file, "%lu %04x\n", frame, keys);
+    writer->started = true;
+    writer->keys = keys;
+}
+
+int chip8_script_close(struct chip8_script_writer *writer)
+{
+    if (!writer->file)
+        return 0;
+    int res = ferror(writer->file) | fclose(writer->file);
+    writer->file = NULL;
+    return res ? -1 : 0;
+}
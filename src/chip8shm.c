@@ -0,0 +1,168 @@
+#include "chip8shm.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Maps the segment, creating it when "create" is set. */
+static int chip8_shm_map(struct chip8_shm *shm, const char *name,
+                         bool create)
+{
+    memset(shm, 0, sizeof(struct chip8_shm));
+    size_t size = sizeof(struct chip8_shm_segment);
+#ifdef _WIN32
+    snprintf(shm->name, sizeof(shm->name), "%s", name);
+    HANDLE mapping;
+    if (create)
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+                                     PAGE_READWRITE, 0, size, shm->name);
+    else
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, shm->name);
+    if (!mapping)
+        return -1;
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return -1;
+    }
+    shm->mapping = mapping;
+#else
+    snprintf(shm->name, sizeof(shm->name), "/%s", name);
+    int fd = shm_open(shm->name, create ? O_RDWR | O_CREAT : O_RDWR, 0600);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if ((create && ftruncate(fd, size) != 0) || fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < size)
+    {
+        close(fd);
+        if (create)
+            shm_unlink(shm->name);
+        return -1;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        if (create)
+            shm_unlink(shm->name);
+        return -1;
+    }
+#endif
+    shm->segment = data;
+    shm->owner = create;
+    return 0;
+}
+
+int chip8_shm_create(struct chip8_shm *shm, const char *name)
+{
+    if (chip8_shm_map(shm, name, true) != 0)
+        return -1;
+
+    struct chip8_shm_segment *segment = shm->segment;
+    memset(segment, 0, sizeof(struct chip8_shm_segment));
+    segment->version = CHIP8_SHM_VERSION;
+    __atomic_store_n(&segment->magic, CHIP8_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int chip8_shm_attach(struct chip8_shm *shm, const char *name)
+{
+    if (chip8_shm_map(shm, name, false) != 0)
+        return -1;
+
+    struct chip8_shm_segment *segment = shm->segment;
+    if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) !=
+        CHIP8_SHM_MAGIC || segment->version != CHIP8_SHM_VERSION)
+    {
+        chip8_shm_close(shm);
+        return -1;
+    }
+    return 0;
+}
+
+void chip8_shm_publish(struct chip8_shm *shm, const struct chip8 *chip8,
+                       uint64_t frame)
+{
+    struct chip8_shm_segment *segment = shm->segment;
+    struct chip8_shm_state *state = &segment->state;
+
+    /* Only the emulator writes the sequence, a plain increment will do. */
+    uint32_t sequence = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    state->frame = frame;
+    memcpy(state->rows, chip8->screen.rows, sizeof(state->rows));
+    memcpy(state->stack, chip8->stack.stack, sizeof(state->stack));
+    memcpy(state->V, chip8->registers.V, sizeof(state->V));
+    state->I = chip8->registers.I;
+    state->PC = chip8->registers.PC;
+    state->delay_timer = chip8_delay_timer(chip8);
+    state->sound_timer = chip8_sound_timer(chip8);
+    state->SP = chip8->registers.SP;
+    state->hires = chip8->screen.hires;
+    state->keyboard = chip8_keyboard_get_mask(&chip8->keyboard);
+
+    __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void chip8_shm_apply_keys(struct chip8_shm *shm, struct chip8 *chip8)
+{
+    uint16_t keys = __atomic_load_n(&shm->segment->keys, __ATOMIC_RELAXED);
+    uint16_t changed = keys ^ shm->keys;
+    uint16_t held = chip8_keyboard_get_mask(&chip8->keyboard);
+    chip8_keyboard_set_mask(&chip8->keyboard, 
+                            (held & ~changed) | (keys & changed));
+    shm->keys = keys;
+}
+
+bool chip8_shm_read(struct chip8_shm *shm, struct chip8_shm_state *state)
+{
+    struct chip8_shm_segment *segment = shm->segment;
+    uint32_t before, after;
+    do
+    {
+        before = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+        {
+            after = before + 1;
+            continue;
+        }
+        memcpy(state, &segment->state, sizeof(struct chip8_shm_state));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+    } while (before != after);
+    return before != 0;
+}
+
+void chip8_shm_set_keys(struct chip8_shm *shm, uint16_t keys)
+{
+    __atomic_store_n(&shm->segment->keys, keys, __ATOMIC_RELAXED);
+}
+
+void chip8_shm_close(struct chip8_shm *shm)
+{
+    if (!shm->segment)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(shm->segment);
+    CloseHandle(shm->mapping);
+#else
+    munmap(shm->segment, sizeof(struct chip8_shm_segment));
+    if (shm->owner)
+        shm_unlink(shm->name);
+#endif
+    shm->segment = NULL;
+}
@@ -5,7 +5,7 @@
 static void chip8_stack_in_bounds(struct chip8 *chip8)
 {
     /* Ensure that the functions do not overflow the stack array. */
-    assert(chip8->registers.SP < sizeof(chip8->stack.stack));        
+    assert(chip8->registers.SP < CHIP8_TOTAL_STACK_DEPTH);
 }
 
 void chip8_stack_push(struct chip8 *chip8, unsigned short val)
@@ -0,0 +1,467 @@
+#include "chip8trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* A record is at most 10 + 3 + 2 + 3 + 16 bytes long. */
+#define CHIP8_TRACE_MAX_RECORD_SIZE 34
+
+static void chip8_trace_put_le(unsigned char *p, unsigned long long val,
+                               int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        p[i] = val >> (8 * i);
+    }
+}
+
+static unsigned long long chip8_trace_get_le(const unsigned char *p, int bytes)
+{
+    unsigned long long val = 0;
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        val = (val << 8) | p[i];
+    }
+    return val;
+}
+
+static unsigned char *chip8_trace_put_varint(unsigned char *p,
+                                             unsigned long long val)
+{
+    while (val >= 0x80)
+    {
+        *p++ = (val & 0x7f) | 0x80;
+        val >>= 7;
+    }
+    *p++ = val;
+    return p;
+}
+
+/* Returns the position after the varint or NULL if it runs past "end". */
+static const unsigned char *chip8_trace_get_varint(const unsigned char *p,
+                                                   const unsigned char *end,
+                                                   unsigned long long *val)
+{
+    *val = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        unsigned char c = *p++;
+        *val |= (unsigned long long)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return p;
+    }
+    return NULL;
+}
+
+static void chip8_trace_flush(struct chip8_trace *trace)
+{
+    if (trace->used)
+    {
+        fwrite(trace->buffer, 1, trace->used, trace->file);
+        trace->offset += trace->used;
+        trace->used = 0;
+    }
+}
+
+int chip8_trace_open(struct chip8_trace *trace, const char *filename)
+{
+    memset(trace, 0, sizeof(struct chip8_trace));
+    trace->file = fopen(filename, "wb");
+    if (!trace->file)
+        return -1;
+
+    unsigned char header[CHIP8_TRACE_HEADER_SIZE] = { 'C', '8', 'T', 'R' };
+    chip8_trace_put_le(&header[4], CHIP8_TRACE_VERSION, 4);
+    chip8_trace_put_le(&header[8], CHIP8_TRACE_CHECKPOINT_INTERVAL, 4);
+    memcpy(trace->buffer, header, sizeof(header));
+    trace->used = sizeof(header);
+    return 0;
+}
+
+static void chip8_trace_checkpoint(struct chip8_trace *trace,
+                                   unsigned long long count)
+{
+    if (trace->unindexed)
+        return;
+
+    if (trace->index_count == trace->index_capacity)
+    {
+        size_t capacity = trace->index_capacity ?
+                          trace->index_capacity * 2 : 256;
+        unsigned long long *index = realloc(trace->index,
+                               capacity * 2 * sizeof(unsigned long long));
+
+        /* Skipping only this entry would shift every later one, the reader 
+        finds checkpoints by their position in the index. */
+        if (!index)
+        {
+            trace->unindexed = true;
+            return;
+        }
+
+        trace->index = index;
+        trace->index_capacity = capacity;
+    }
+
+    trace->index[trace->index_count * 2] = count;
+    trace->index[trace->index_count * 2 + 1] = trace->offset + trace->used;
+    trace->index_count++;
+}
+
+void chip8_trace_record(struct chip8_trace *trace, unsigned long long count,
+                        unsigned short pc, unsigned short opcode,
+                        const unsigned char *V)
+{
+    if (trace->used + CHIP8_TRACE_MAX_RECORD_SIZE > CHIP8_TRACE_BUFFER_SIZE)
+        chip8_trace_flush(trace);
+
+    /* Every interval the delta base is reset so the record is absolute. */
+    if (trace->records % CHIP8_TRACE_CHECKPOINT_INTERVAL == 0)
+    {
+        chip8_trace_checkpoint(trace, count);
+        trace->last_count = 0;
+        trace->last_pc = 0;
+        memset(trace->last_V, 0, sizeof(trace->last_V));
+    }
+
+    unsigned short changed = 0;
+    for (int i = 0; i < CHIP8_TOTAL_DATA_REGISTERS; ++i)
+    {
+        if (V[i] != trace->last_V[i])
+            changed |= 1 << i;
+    }
+
+    /* Straight line code advances the PC by 2, which encodes as zero. */
+    int pc_delta = (int)pc - (int)trace->last_pc - 2;
+
+    unsigned char *p = &trace->buffer[trace->used];
+    p = chip8_trace_put_varint(p, count - trace->last_count);
+    p = chip8_trace_put_varint(p, ((unsigned)pc_delta << 1) ^
+                                  (unsigned)(pc_delta >> 31));
+    *p++ = opcode >> 8;
+    *p++ = opcode & 0xff;
+    p = chip8_trace_put_varint(p, changed);
+    for (int i = 0; i < CHIP8_TOTAL_DATA_REGISTERS; ++i)
+    {
+        if (changed & (1 << i))
+        {
+            *p++ = V[i];
+            trace->last_V[i] = V[i];
+        }
+    }
+
+    trace->used = p - trace->buffer;
+    trace->last_count = count;
+    trace->last_pc = pc;
+    trace->records++;
+}
+
+int chip8_trace_close(struct chip8_trace *trace)
+{
+    chip8_trace_flush(trace);
+
+    if (!trace->unindexed)
+    {
+        unsigned long long index_offset = trace->offset;
+        for (size_t i = 0; i < trace->index_count; ++i)
+        {
+            unsigned char entry[CHIP8_TRACE_INDEX_ENTRY_SIZE];
+            chip8_trace_put_le(&entry[0], trace->index[i * 2], 8);
+            chip8_trace_put_le(&entry[8], trace->index[i * 2 + 1], 8);
+            fwrite(entry, 1, sizeof(entry), trace->file);
+        }
+
+        unsigned char trailer[CHIP8_TRACE_TRAILER_SIZE] = {'C', '8', 'T', 'I'};
+        chip8_trace_put_le(&trailer[4], index_offset, 8);
+        chip8_trace_put_le(&trailer[12], trace->index_count, 8);
+        fwrite(trailer, 1, sizeof(trailer), trace->file);
+    }
+
+    int res = ferror(trace->file) ? -1 : 0;
+    if (fclose(trace->file) != 0)
+        res = -1;
+
+    free(trace->index);
+    trace->index = NULL;
+    trace->file = NULL;
+    return res;
+}
+
+static int chip8_trace_map(struct chip8_trace_reader *reader,
+                           const char *filename)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return -1;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return -1;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return -1;
+
+    reader->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!reader->data)
+    {
+        CloseHandle(mapping);
+        return -1;
+    }
+    reader->mapping = mapping;
+    reader->size = size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+
+    reader->data = data;
+    reader->size = st.st_size;
+#endif
+    return 0;
+}
+
+static void chip8_trace_unmap(struct chip8_trace_reader *reader)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(reader->data);
+    CloseHandle(reader->mapping);
+#else
+    munmap((void *)reader->data, reader->size);
+#endif
+    reader->data = NULL;
+}
+
+static void chip8_trace_reader_rewind(struct chip8_trace_reader *reader,
+                                      size_t pos, unsigned long record)
+{
+    reader->pos = pos;
+    reader->record = record;
+    reader->last_count = 0;
+    reader->last_pc = 0;
+}
+
+/* Rebuilds the index of a trace that was not closed cleanly by scanning it. */
+static int chip8_trace_reader_rebuild_index(struct chip8_trace_reader *reader)
+{
+    size_t capacity = 256;
+    unsigned char *index = malloc(capacity * CHIP8_TRACE_INDEX_ENTRY_SIZE);
+    if (!index)
+        return -1;
+
+    size_t count = 0;
+    struct chip8_trace_record record;
+    size_t pos = reader->pos;
+    while (chip8_trace_reader_next(reader, &record) == 1)
+    {
+        if ((reader->record - 1) % reader->interval == 0)
+        {
+            if (count == capacity)
+            {
+                capacity *= 2;
+                unsigned char *grown = realloc(index,
+                                    capacity * CHIP8_TRACE_INDEX_ENTRY_SIZE);
+                if (!grown)
+                {
+                    free(index);
+                    return -1;
+                }
+                index = grown;
+            }
+            chip8_trace_put_le(&index[count * CHIP8_TRACE_INDEX_ENTRY_SIZE],
+                               record.count, 8);
+            chip8_trace_put_le(&index[count * CHIP8_TRACE_INDEX_ENTRY_SIZE + 8],
+                               pos, 8);
+            count++;
+        }
+        pos = reader->pos;
+    }
+
+    reader->index = index;
+    reader->index_count = count;
+    reader->owned = 1;
+    return 0;
+}
+
+int chip8_trace_reader_open(struct chip8_trace_reader *reader,
+                            const char *filename)
+{
+    memset(reader, 0, sizeof(struct chip8_trace_reader));
+    if (chip8_trace_map(reader, filename) != 0)
+        return -1;
+
+    const unsigned char *data = reader->data;
+    if (reader->size < CHIP8_TRACE_HEADER_SIZE || memcmp(data, "C8TR", 4) != 0
+        || chip8_trace_get_le(&data[4], 4) != CHIP8_TRACE_VERSION
+        || chip8_trace_get_le(&data[8], 4) == 0)
+    {
+        chip8_trace_unmap(reader);
+        return -1;
+    }
+    reader->interval = chip8_trace_get_le(&data[8], 4);
+    reader->end = reader->size;
+
+    /* Use the index footer when the writer was closed cleanly. */
+    if (reader->size >= CHIP8_TRACE_HEADER_SIZE + CHIP8_TRACE_TRAILER_SIZE)
+    {
+        const unsigned char *trailer = &data[reader->size -
+                                             CHIP8_TRACE_TRAILER_SIZE];
+        unsigned long long offset = chip8_trace_get_le(&trailer[4], 8);
+        unsigned long long count = chip8_trace_get_le(&trailer[12], 8);
+        if (memcmp(trailer, "C8TI", 4) == 0 &&
+            offset >= CHIP8_TRACE_HEADER_SIZE &&
+            count <= reader->size / CHIP8_TRACE_INDEX_ENTRY_SIZE &&
+            offset + count * CHIP8_TRACE_INDEX_ENTRY_SIZE ==
+                reader->size - CHIP8_TRACE_TRAILER_SIZE)
+        {
+            reader->end = offset;
+            reader->index = &data[offset];
+            reader->index_count = count;
+        }
+    }
+
+    chip8_trace_reader_rewind(reader, CHIP8_TRACE_HEADER_SIZE, 0);
+    if (!reader->index)
+    {
+        if (chip8_trace_reader_rebuild_index(reader) != 0)
+        {
+            chip8_trace_unmap(reader);
+            return -1;
+        }
+        chip8_trace_reader_rewind(reader, CHIP8_TRACE_HEADER_SIZE, 0);
+    }
+    return 0;
+}
+
+int chip8_trace_reader_seek(struct chip8_trace_reader *reader,
+                            unsigned long long count)
+{
+    /* Find the last checkpoint at or before "count". */
+    size_t lo = 0;
+    size_t hi = reader->index_count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        const unsigned char *entry = &reader->index[mid *
+                                                CHIP8_TRACE_INDEX_ENTRY_SIZE];
+        if (chip8_trace_get_le(entry, 8) <= count)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0)
+    {
+        chip8_trace_reader_rewind(reader, CHIP8_TRACE_HEADER_SIZE, 0);
+    }
+    else
+    {
+        const unsigned char *entry = &reader->index[(lo - 1) *
+                                                CHIP8_TRACE_INDEX_ENTRY_SIZE];
+        unsigned long long pos = chip8_trace_get_le(&entry[8], 8);
+        if (pos < CHIP8_TRACE_HEADER_SIZE || pos > reader->end)
+            return -1;
+        chip8_trace_reader_rewind(reader, pos, (lo - 1) * reader->interval);
+    }
+
+    /* At most one interval of records is decoded from the checkpoint. */
+    while (1)
+    {
+        struct chip8_trace_reader saved = *reader;
+        struct chip8_trace_record record;
+        int res = chip8_trace_reader_next(reader, &record);
+        if (res <= 0)
+            return res;
+
+        if (record.count >= count)
+        {
+            *reader = saved;
+            return 0;
+        }
+    }
+}
+
+int chip8_trace_reader_next(struct chip8_trace_reader *reader,
+                            struct chip8_trace_record *record)
+{
+    const unsigned char *p = &reader->data[reader->pos];
+    const unsigned char *end = &reader->data[reader->end];
+    if (p == end)
+        return 0;
+
+    if (reader->record % reader->interval == 0)
+    {
+        reader->last_count = 0;
+        reader->last_pc = 0;
+        memset(reader->last_V, 0, sizeof(reader->last_V));
+    }
+
+    unsigned long long count_delta, pc_zigzag, changed;
+    p = chip8_trace_get_varint(p, end, &count_delta);
+    if (p)
+        p = chip8_trace_get_varint(p, end, &pc_zigzag);
+    if (!p || end - p < 2)
+        return -1;
+
+    unsigned short opcode = p[0] << 8 | p[1];
+    p = chip8_trace_get_varint(p + 2, end, &changed);
+    if (!p || changed > 0xffff)
+        return -1;
+
+    int pc_delta = (int)(pc_zigzag >> 1) ^ -(int)(pc_zigzag & 1);
+    record->count = reader->last_count + count_delta;
+    record->pc = reader->last_pc + 2 + pc_delta;
+    record->opcode = opcode;
+    record->changed = changed;
+    memcpy(record->V, reader->last_V, sizeof(record->V));
+    for (int i = 0; i < CHIP8_TOTAL_DATA_REGISTERS; ++i)
+    {
+        if (changed & (1 << i))
+        {
+            if (p == end)
+                return -1;
+            record->V[i] = *p++;
+        }
+    }
+
+    reader->pos = p - reader->data;
+    reader->last_count = record->count;
+    reader->last_pc = record->pc;
+    memcpy(reader->last_V, record->V, sizeof(reader->last_V));
+    reader->record++;
+    return 1;
+}
+
+void chip8_trace_reader_close(struct chip8_trace_reader *reader)
+{
+    if (reader->owned)
+        free((void *)reader->index);
+    reader->index = NULL;
+    chip8_trace_unmap(reader);
+}
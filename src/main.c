@@ -1,9 +1,40 @@
 #include <stdio.h>
 #include <stdbool.h>
-#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "SDL2/SDL.H"
 #include "chip8.h"
 #include "chip8keyboard.h"
+#include "chip8trace.h"
+#include "chip8debug.h"
+#include "chip8disasm.h"
+#include "chip8audio.h"
+#include "chip8romdb.h"
+#include "chip8recorder.h"
+#include "chip8script.h"
+#include "chip8netplay.h"
+#include "chip8shm.h"
+#include "chip8scale.h"
+#include "chip8phosphor.h"
+#include "chip8profile.h"
+
+/* Colours of the four XO-CHIP plane combinations. Programs using only the 
+first plane are white on black. */
+const SDL_Color palette[1 << CHIP8_TOTAL_PLANES] = 
+{
+    {0, 0, 0, 0}, {255, 255, 255, 0}, {170, 170, 170, 0}, {85, 85, 85, 0}
+};
+
+#define AUDIO_SAMPLE_RATE 44100
+
+/* Subroutines listed after profiling. */
+#define PROFILE_SUMMARY_SIZE 10
+
+/* GIF recordings are 512x256. */
+#define RECORD_SCALE 4
+
+#define TURBO_WINDOW_TITLE EMULATOR_WINDOW_TITLE " (turbo)"
 
 const char keyboard_map[CHIP8_TOTAL_KEYS] = 
 {
@@ -12,6 +43,198 @@ const char keyboard_map[CHIP8_TOTAL_KEYS] =
     SDLK_c, SDLK_d, SDLK_e, SDLK_f
 };
 
+/* Draws each pixel as a rectangle. The window keeps its size, high 
+resolution pixels are smaller. */
+static void draw_blocks(SDL_Renderer *renderer, struct chip8_screen *screen)
+{
+    int width = chip8_screen_width(screen);
+    int height = chip8_screen_height(screen);
+    int multiplier = CHIP8_WINDOW_MULTIPLIER * CHIP8_WIDTH / width;
+    for (int x = 0; x < width; ++x)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            int color = chip8_screen_get(screen, x, y);
+            if (color)
+            {
+                SDL_SetRenderDrawColor(renderer, palette[color].r, 
+                                       palette[color].g, palette[color].b, 
+                                       0);
+                SDL_Rect r;
+                r.x = x * multiplier;
+                r.y = y * multiplier;
+                r.w = multiplier;
+                r.h = multiplier;
+                SDL_RenderFillRect(renderer, &r);
+            }
+        }
+    }
+}
+
+/* Draws the screen through an upscaling filter of chip8scale.h and
+phosphor persistence, when not NULL, into a texture the size of the
+filter's output. */
+static void draw_filtered(SDL_Renderer *renderer, SDL_Texture *texture,
+                          int filter, struct chip8_phosphor *phosphor,
+                          struct chip8_screen *screen)
+{
+    static unsigned char filtered[CHIP8_SCALE_MAX_SIZE];
+    static Uint32 pixels[CHIP8_SCALE_MAX_SIZE];
+    int width = CHIP8_HIRES_WIDTH * chip8_scale_factor(filter);
+    int height = CHIP8_HIRES_HEIGHT * chip8_scale_factor(filter);
+    chip8_scale_render(filter, screen, filtered);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        const SDL_Color *c = &palette[filtered[i]];
+        pixels[i] = 0xff000000 | c->r << 16 | c->g << 8 | c->b;
+    }
+    if (phosphor)
+        chip8_phosphor_blend(phosphor, (unsigned char *)pixels);
+    SDL_UpdateTexture(texture, NULL, pixels, width * sizeof(Uint32));
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+}
+
+/* Parses "ADDR" or "ADDR:Vx=KK" (also !=, < and >), all numbers in hex. */
+static int parse_breakpoint(const char *arg, struct chip8_breakpoint *bp)
+{
+    char op[3] = {0};
+    unsigned int address, reg, value;
+    memset(bp, 0, sizeof(struct chip8_breakpoint));
+
+    if (sscanf(arg, "%x:V%1x%2[!=<>]%x", &address, &reg, op, &value) == 4)
+    {
+        bp->reg = reg;
+        bp->value = value;
+        if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+            bp->condition = CHIP8_CONDITION_EQUAL;
+        else if (strcmp(op, "!=") == 0)
+            bp->condition = CHIP8_CONDITION_NOT_EQUAL;
+        else if (strcmp(op, "<") == 0)
+            bp->condition = CHIP8_CONDITION_LESS;
+        else if (strcmp(op, ">") == 0)
+            bp->condition = CHIP8_CONDITION_GREATER;
+        else
+            return -1;
+    }
+    else if (sscanf(arg, "%x", &address) != 1)
+    {
+        return -1;
+    }
+
+    /* Checked before they are narrowed to the breakpoint's fields. */
+    if (address >= CHIP8_MEMORY_SIZE || 
+        (bp->condition != CHIP8_CONDITION_ALWAYS && value > 0xff))
+    {
+        return -1;
+    }
+    bp->address = address;
+    return 0;
+}
+
+static void print_stop(struct chip8 *chip8, const char *what)
+{
+    printf("%s at PC=%03X I=%03X:", what, chip8->registers.PC, 
+           chip8->registers.I);
+    for (int i = 0; i < CHIP8_TOTAL_DATA_REGISTERS; ++i)
+    {
+        printf(" V%X=%02X", i, chip8->registers.V[i]);
+    }
+    printf("\n");
+
+    /* Show the next few instructions. */
+    char listing[4 * CHIP8_DISASM_MAX_LINE + 1];
+    int pc = chip8->registers.PC;
+    int size = CHIP8_MEMORY_SIZE - pc < 8 ? CHIP8_MEMORY_SIZE - pc : 8;
+    chip8_disasm(&chip8->memory.memory[pc], size, pc, listing);
+    printf("%sPress F5 to continue or F10 to step.\n", listing);
+}
+
+/* Runs one frame worth of instructions, recording each one when tracing or 
+profiling. */
+static enum chip8_stop_reason run_frame(struct chip8 *chip8, 
+                                        struct chip8_debugger *debugger,
+                                        struct chip8_trace *trace,
+                                        struct chip8_profile *profile)
+{
+    if (!trace && !profile)
+        return chip8_debug_run(debugger, chip8, chip8->instructions_per_frame);
+
+    for (int i = 0; i < chip8->instructions_per_frame; ++i)
+    {
+        unsigned short pc = chip8->registers.PC;
+        unsigned short opcode = chip8_memory_get_short(&chip8->memory, pc);
+        unsigned long long count = chip8->instruction_count;
+
+        enum chip8_stop_reason reason = chip8_debug_run(debugger, chip8, 1);
+        if (chip8->instruction_count != count && trace)
+        {
+            chip8_trace_record(trace, count, pc, opcode, chip8->registers.V);
+        }
+        if (chip8->instruction_count != count && profile)
+        {
+            chip8_profile_record(profile, chip8);
+        }
+        if (reason != CHIP8_STOP_BUDGET)
+            return reason;
+    }
+    return CHIP8_STOP_BUDGET;
+}
+
+/* "--pack ARCHIVE ROM..." packs the ROMs into an archive, each named after 
+its file. */
+static int pack_roms(int count, char **args)
+{
+    if (count < 2)
+    {
+        printf("Usage: --pack ARCHIVE ROM...\n");
+        return(-1);
+    }
+
+    int total = count - 1;
+    struct chip8_rom_file *files = calloc(total, sizeof(*files));
+    struct chip8_rom *roms = calloc(total, sizeof(*roms));
+    const char **names = calloc(total, sizeof(*names));
+    int res = files && roms && names ? CHIP8_ROM_OK : CHIP8_ROM_ERROR_OPEN;
+    int opened = 0;
+    for (; opened < total && res == CHIP8_ROM_OK; ++opened)
+    {
+        const char *path = args[opened + 1];
+        res = chip8_rom_open(&files[opened], path, &roms[opened]);
+        if (res != CHIP8_ROM_OK)
+        {
+            printf("Failed to load %s: %s\n", path, 
+                   chip8_rom_error_string(res));
+            break;
+        }
+
+        const char *name = path;
+        for (const char *p = path; *p; ++p)
+        {
+            if (*p == '/' || *p == '\\')
+                name = p + 1;
+        }
+        names[opened] = name;
+    }
+
+    if (res == CHIP8_ROM_OK)
+    {
+        res = chip8_rom_archive_write(args[0], names, roms, total);
+        if (res != CHIP8_ROM_OK)
+            printf("Failed to write %s: %s\n", args[0], 
+                   chip8_rom_error_string(res));
+    }
+
+    for (int i = 0; i < opened; ++i)
+    {
+        chip8_rom_close(&files[i]);
+    }
+    free(files);
+    free(roms);
+    free(names);
+    return res == CHIP8_ROM_OK ? 0 : -1;
+}
+
 int main(int argc, char **argv)
 {
     if (argc < 2)
@@ -20,49 +243,353 @@ int main(int argc, char **argv)
         return(-1);
     }
 
+    if (strcmp(argv[1], "--pack") == 0)
+    {
+        return pack_roms(argc - 2, argv + 2);
+    }
+
     const char *filename = argv[1];
     printf("The filename to load is: %s\n", filename);
 
-    FILE *f = fopen(filename, "rb");        /*Open the file for reading only.*/
-
-    if (!f)
+    /* Optional arguments follow the file to load. */
+    const char *trace_filename = NULL;
+    const char *profile_filename = NULL;
+    const char *record_filename = NULL;
+    const char *archive_filename = NULL;
+    const char *netplay_arg = NULL;
+    const char *shm_name = NULL;
+    const char *keys_filename = NULL;
+    bool seeded = false;
+    uint32_t seed = 0;
+    bool disassemble = false;
+    int quirks = -1;
+    int filter = CHIP8_SCALE_NONE;
+    int persistence = -1;
+    bool fast_forward = false;
+    int turbo = 0;
+    struct chip8_debugger debugger;
+    chip8_debug_init(&debugger);
+    for (int i = 2; i < argc; ++i)
     {
-        printf("Faile to open the file\n");
-        return(-1);
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            /* Collapsed call stacks for flame graphs, see chip8profile.h. */
+            profile_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            record_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc)
+        {
+            /* The file to load names a ROM inside this archive. */
+            archive_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--netplay") == 0 && i + 1 < argc)
+        {
+            /* LOCALPORT:HOST:PORT, both sides must load the same ROM. */
+            netplay_arg = argv[++i];
+        }
+        else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+        {
+            /* Shares the screen, registers and keys, see chip8shm.h. */
+            shm_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record-keys") == 0 && i + 1 < argc)
+        {
+            /* The input script chip8-golden and chip8-headless replay. */
+            keys_filename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seeded = true;
+            seed = strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--disasm") == 0)
+        {
+            disassemble = true;
+        }
+        else if (strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+        {
+            quirks = chip8_quirks_parse(argv[++i]);
+            if (quirks < 0)
+            {
+                printf("Unknown quirk profile: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            /* Smooths the screen with Scale2x or Scale3x. */
+            filter = chip8_scale_parse(argv[++i]);
+            if (filter < 0)
+            {
+                printf("Unknown filter: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--phosphor") == 0 && i + 1 < argc)
+        {
+            /* The percentage of brightness left after a frame. */
+            persistence = atoi(argv[++i]);
+            if (persistence < 0 || persistence > 99)
+            {
+                printf("The persistence must be 0 to 99\n");
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--turbo") == 0 && i + 1 < argc)
+        {
+            /* Starts fast-forwarded, N times as fast or 0 for as fast as
+            it goes. Tab switches between that and normal speed. */
+            turbo = atoi(argv[++i]);
+            fast_forward = true;
+            if (turbo < 0)
+            {
+                printf("The turbo multiplier must be 0 or more\n");
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--romdb") == 0 && i + 1 < argc)
+        {
+            if (chip8_romdb_load_overrides(argv[++i]) != 0)
+            {
+                printf("Invalid ROM database: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--break") == 0 && i + 1 < argc)
+        {
+            struct chip8_breakpoint bp;
+            if (parse_breakpoint(argv[++i], &bp) != 0 || 
+                chip8_debug_add_breakpoint(&debugger, &bp) != 0)
+            {
+                printf("Invalid breakpoint: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+        {
+            unsigned int start, end;
+            int n = sscanf(argv[++i], "%x-%x", &start, &end);
+            if (n == 1)
+                end = start;
+            if (n < 1 || start >= CHIP8_MEMORY_SIZE || 
+                end >= CHIP8_MEMORY_SIZE || 
+                chip8_debug_add_watchpoint(&debugger, start, end) != 0)
+            {
+                printf("Invalid watchpoint: %s\n", argv[i]);
+                return(-1);
+            }
+        }
+        else
+        {
+            printf("Unknown argument: %s\n", argv[i]);
+            return(-1);
+        }
     }
 
-    fseek(f, 0, SEEK_END);                   /* Seek to the end of the file.*/
-    long size = ftell(f);                    /* Tell the OS the pos we're at.*/
-    fseek(f, 0, 0);                            
-
-    char buf[size];                          /* A buffer. */
-    int res = fread(buf, size, 1, f);
+    /* The ROM is mapped, not read, and stays mapped until it's loaded. */
+    struct chip8_rom_file rom_file = {0};
+    struct chip8_rom_archive archive = {0};
+    struct chip8_rom rom;
+    int res;
+    if (archive_filename)
+    {
+        res = chip8_rom_archive_open(&archive, archive_filename);
+        if (res == CHIP8_ROM_OK)
+            res = chip8_rom_archive_find(&archive, filename, &rom);
+    }
+    else
+    {
+        res = chip8_rom_open(&rom_file, filename, &rom);
+    }
 
-    if (res != 1)
+    if (res != CHIP8_ROM_OK)
     {
-        printf("Faile to read from file\n");
+        printf("Failed to load %s: %s\n", filename, 
+               chip8_rom_error_string(res));
         return(-1);
     }
 
+    if (disassemble)
+    {
+        /* List the program and exit without starting the emulator. */
+        char *listing = malloc((rom.size + 1) / 2 * CHIP8_DISASM_MAX_LINE + 
+                               1);
+        if (!listing)
+            return(-1);
+        chip8_disasm(rom.data, rom.size, CHIP8_PROGRAM_LOAD_ADDRESS, listing);
+        fputs(listing, stdout);
+        free(listing);
+        return(0);
+    }
+
     struct chip8 chip8;
     chip8_init(&chip8); 
-    chip8_load(&chip8, buf, size);   
     chip8_keyboard_set_map(&chip8.keyboard, keyboard_map);
+    /* Netplay needs both sides to draw the same random numbers, and 
+    recorded keys replay with chip8_init's seed of 0. */
+    chip8_seed(&chip8, seeded || netplay_arg || keys_filename ? 
+                       seed : (uint32_t)time(NULL));
+    res = chip8_load(&chip8, (const char *)rom.data, rom.size);
+    chip8_rom_archive_close(&archive);
+    chip8_rom_close(&rom_file);
+    if (res != CHIP8_ROM_OK)
+    {
+        printf("Failed to load %s: %s\n", filename, 
+               chip8_rom_error_string(res));
+        return(-1);
+    }
+    if (quirks >= 0)
+        chip8.quirks = quirks;
+
+    const struct chip8_romdb_entry *entry = chip8_romdb_find(chip8.rom_hash);
+    printf("ROM %016llx (%s), %d instructions per frame\n", 
+           (unsigned long long)chip8.rom_hash, 
+           entry ? (entry->name ? entry->name : "override") : "unknown",
+           chip8.instructions_per_frame);
+
+    /* Holds the snapshots, keep it off the stack. */
+    static struct chip8_netplay netplay;
+    if (netplay_arg)
+    {
+        char host[256];
+        int local_port, peer_port;
+        if (chip8_netplay_parse(netplay_arg, &local_port, host, sizeof(host), 
+                                &peer_port) != 0 ||
+            chip8_netplay_open(&netplay, &chip8, local_port, host, 
+                               peer_port) != 0)
+        {
+            printf("Failed to start netplay: %s\n", netplay_arg);
+            return(-1);
+        }
+    }
+    struct chip8_shm shm = {0};
+    if (shm_name && chip8_shm_create(&shm, shm_name) != 0)
+    {
+        printf("Failed to create shared memory: %s\n", shm_name);
+        return(-1);
+    }
+
+    /* With netplay the keyboard is set every frame from both players. */
+    uint16_t local_keys = 0;
+
+    /* The trace writer holds its buffer inline, keep it off the stack. */
+    static struct chip8_trace trace;
+    if (trace_filename && chip8_trace_open(&trace, trace_filename) != 0)
+    {
+        printf("Failed to open the trace file\n");
+        return(-1);
+    }
+    struct chip8_profile profile = {0};
+    if (profile_filename && chip8_profile_init(&profile, &chip8) != 0)
+    {
+        printf("Failed to start the profiler\n");
+        return(-1);
+    }
+    bool paused = false;
 
     SDL_Init(SDL_INIT_EVERYTHING);
+
+    /* Encoded on its own thread, the emulator only copies each frame. */
+    static struct chip8_recorder recorder;
+    if (record_filename && 
+        chip8_recorder_open(&recorder, record_filename, RECORD_SCALE) != 0)
+    {
+        printf("Failed to open the recording file\n");
+        return(-1);
+    }
+    struct chip8_script_writer keys_script = {0};
+    if (keys_filename && chip8_script_create(&keys_script, keys_filename) != 0)
+    {
+        printf("Failed to open the key script\n");
+        return(-1);
+    }
+    unsigned long long emulated_frames = 0;
+
+    /* A filtered image is shown in whole blocks of its pixels, the window
+    being as close as that gets to its usual size. */
+    bool filtering = filter != CHIP8_SCALE_NONE || persistence >= 0;
+    int window_width = CHIP8_WIDTH * CHIP8_WINDOW_MULTIPLIER;
+    int window_height = CHIP8_HEIGHT * CHIP8_WINDOW_MULTIPLIER;
+    int filtered_width = CHIP8_HIRES_WIDTH * chip8_scale_factor(filter);
+    int filtered_height = CHIP8_HIRES_HEIGHT * chip8_scale_factor(filter);
+    if (filtering)
+    {
+        int blocks = (window_width + filtered_width / 2) / filtered_width;
+        window_width = blocks * filtered_width;
+        window_height = blocks * filtered_height;
+    }
     SDL_Window *window = SDL_CreateWindow(
-        EMULATOR_WINDOW_TITLE,
+        fast_forward ? TURBO_WINDOW_TITLE : EMULATOR_WINDOW_TITLE,
         SDL_WINDOWPOS_UNDEFINED,
         SDL_WINDOWPOS_UNDEFINED,
-        CHIP8_WIDTH * CHIP8_WINDOW_MULTIPLIER, 
-        CHIP8_HEIGHT * CHIP8_WINDOW_MULTIPLIER, SDL_WINDOW_SHOWN
+        window_width, window_height, SDL_WINDOW_SHOWN
     );
 
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 
                                                 SDL_TEXTUREACCESS_TARGET);
+    SDL_Texture *texture = NULL;
+    if (filtering)
+    {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    filtered_width, filtered_height);
+    }
+    struct chip8_phosphor phosphor = {0};
+    if (persistence >= 0 &&
+        chip8_phosphor_init(&phosphor, (size_t)filtered_width * 
+                            filtered_height * sizeof(Uint32), 
+                            persistence) != 0)
+    {
+        printf("Failed to allocate the phosphor levels\n");
+        return(-1);
+    }
+
+    SDL_AudioSpec want = {0};
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_U8;
+    want.channels = 1;
+    want.samples = 512;
+    SDL_AudioDeviceID audio = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+    SDL_PauseAudioDevice(audio, 0);
+    double audio_phase = 0;
+    Uint32 frame_start = SDL_GetTicks();
+    unsigned int frames = 0;
+
+    /* The screen last presented. */
+    static struct chip8_screen shown;
+    bool redraw = true;
 
     while (1)
     {
+        /* Sleep until the next frame is due, waking for input to handle it 
+        at once. When running far behind, start counting again rather than 
+        running frames back to back to catch up. While paused nothing 
+        happens until a key is pressed, netplay still hears from its peer. */
+        Uint32 next_frame = frame_start + 
+                            frames * 1000ULL / CHIP8_FRAMES_PER_SECOND;
+        Sint32 wait = (Sint32)(next_frame - SDL_GetTicks());
+        bool idle = paused && !netplay_arg;
+        if (idle)
+        {
+            SDL_WaitEvent(NULL);
+        }
+        else if (wait > 0)
+        {
+            SDL_WaitEventTimeout(NULL, wait);
+        }
+        else if (wait < -100)
+        {
+            frame_start = SDL_GetTicks();
+            frames = 0;
+        }
+
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
@@ -72,11 +599,43 @@ int main(int argc, char **argv)
                 goto out;
                 break;
 
+            case SDL_WINDOWEVENT:
+                redraw = true;
+                break;
+
             case SDL_KEYDOWN:
             {
+                if (paused && event.key.keysym.sym == SDLK_F5)
+                {
+                    paused = false;
+                    break;
+                }
+                if (paused && event.key.keysym.sym == SDLK_F10)
+                {
+                    chip8_step(&chip8);
+                    debugger.resuming = false;
+                    print_stop(&chip8, "Step");
+                    break;
+                }
+
+                /* Netplay stays in step with the peer. */
+                if (event.key.keysym.sym == SDLK_TAB && !netplay_arg)
+                {
+                    fast_forward = !fast_forward;
+                    SDL_ClearQueuedAudio(audio);
+                    SDL_SetWindowTitle(window, fast_forward ? 
+                                       TURBO_WINDOW_TITLE : 
+                                       EMULATOR_WINDOW_TITLE);
+                    break;
+                }
+
                 char key = event.key.keysym.sym;
                 int vkey = chip8_keyboard_map(&chip8.keyboard, key);
-                if (vkey != -1)
+                if (vkey != -1 && netplay_arg)
+                {
+                    local_keys |= 1 << vkey;
+                }
+                else if (vkey != -1)
                 {
                     chip8_keyboard_down(&chip8.keyboard, vkey);
                 }
@@ -87,7 +646,11 @@ int main(int argc, char **argv)
             {
                 char key = event.key.keysym.sym;
                 int vkey = chip8_keyboard_map(&chip8.keyboard, key);
-                if (vkey != -1)
+                if (vkey != -1 && netplay_arg)
+                {
+                    local_keys &= ~(1 << vkey);
+                }
+                else if (vkey != -1)
                 {
                     chip8_keyboard_up(&chip8.keyboard, vkey);
                 }
@@ -96,52 +659,166 @@ int main(int argc, char **argv)
             };
         }
 
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-        SDL_RenderClear(renderer);
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 0);
+        /* Woken by input before the frame is due. */
+        if (!idle && (Sint32)(next_frame - SDL_GetTicks()) > 0)
+            continue;
 
-        for (int x = 0; x < CHIP8_WIDTH; ++x)
+        /* Nothing is drawn while the screen stays the same, unless the 
+        phosphor is still fading. */
+        if (redraw || persistence >= 0 || 
+            memcmp(&shown, &chip8.screen, sizeof(shown)) != 0)
         {
-            for (int y = 0; y < CHIP8_HEIGHT; ++y)
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+            SDL_RenderClear(renderer);
+            if (texture)
             {
-                if (chip8_screen_is_set(&chip8.screen, x, y))
+                draw_filtered(renderer, texture, filter, 
+                              persistence >= 0 ? &phosphor : NULL, 
+                              &chip8.screen);
+            }
+            else
+            {
+                draw_blocks(renderer, &chip8.screen);
+            }
+            SDL_RenderPresent(renderer);
+            shown = chip8.screen;
+            redraw = false;
+        }
+
+        /* Keys held through shared memory, netplay has its own. */
+        unsigned long long published = emulated_frames;
+        if (shm_name && !netplay_arg)
+        {
+            chip8_shm_apply_keys(&shm, &chip8);
+        }
+
+        /* Netplay runs whole frames, without the debugger. A frame that 
+        can't run yet waits for the peer's input until the next one. */
+        if (netplay_arg)
+        {
+            bool sound = chip8_sound_timer(&chip8) > 0;
+            if (chip8_netplay_advance(&netplay, local_keys))
+            {
+                if (sound)
                 {
-                    SDL_Rect r;
-                    r.x = x * CHIP8_WINDOW_MULTIPLIER;
-                    r.y = y * CHIP8_WINDOW_MULTIPLIER;
-                    r.w = CHIP8_WINDOW_MULTIPLIER;
-                    r.h = CHIP8_WINDOW_MULTIPLIER;
-                    SDL_RenderFillRect(renderer, &r);
+                    static unsigned char samples[AUDIO_SAMPLE_RATE / 
+                                                 CHIP8_FRAMES_PER_SECOND];
+                    chip8_audio_render(&chip8, samples, sizeof(samples), 
+                                       AUDIO_SAMPLE_RATE, &audio_phase);
+                    SDL_QueueAudio(audio, samples, sizeof(samples));
                 }
+                if (record_filename)
+                {
+                    chip8_recorder_push(&recorder, &chip8.screen, 
+                                        emulated_frames);
+                }
+                emulated_frames++;
+                if (chip8.exited)
+                    goto out;
             }
         }
 
-        SDL_RenderPresent(renderer);
-        if (chip8.registers.delay_timer > 0)
+        /* Run one frame, 1/60s, of the program. Fast-forwarding runs 
+        "turbo" frames before showing one, or as many as fit in 1/60s when 
+        it's 0, without sound. */
+        else if (!paused)
         {
-            Sleep(1);
-            chip8.registers.delay_timer -=1;
+            Uint32 batch_start = SDL_GetTicks();
+            for (int n = 0; !paused; ++n)
+            {
+                if (!fast_forward || turbo > 0)
+                {
+                    if (n == (fast_forward ? turbo : 1))
+                        break;
+                }
+                else if (n > 0 && SDL_GetTicks() - batch_start >= 
+                                  1000 / CHIP8_FRAMES_PER_SECOND)
+                {
+                    break;
+                }
+
+                if (keys_filename)
+                {
+                    chip8_script_write(&keys_script, emulated_frames, 
+                        chip8_keyboard_get_mask(&chip8.keyboard));
+                }
+
+                enum chip8_stop_reason reason = run_frame(&chip8, &debugger, 
+                                    trace_filename ? &trace : NULL,
+                                    profile_filename ? &profile : NULL);
+                if (reason == CHIP8_STOP_EXIT)
+                {
+                    goto out;
+                }
+                else if (reason != CHIP8_STOP_BUDGET)
+                {
+                    print_stop(&chip8, reason == CHIP8_STOP_BREAKPOINT ? 
+                                       "Breakpoint" : "Watchpoint");
+                    paused = true;
+                }
+
+                if (chip8_sound_timer(&chip8) > 0)
+                {
+                    /* Play one frame of the audio pattern per timer tick. */
+                    static unsigned char samples[AUDIO_SAMPLE_RATE / 
+                                                 CHIP8_FRAMES_PER_SECOND];
+                    chip8_audio_render(&chip8, samples, sizeof(samples), 
+                                       AUDIO_SAMPLE_RATE, &audio_phase);
+                    if (!fast_forward)
+                        SDL_QueueAudio(audio, samples, sizeof(samples));
+                }
+                chip8_end_frame(&chip8);
+
+                if (record_filename)
+                {
+                    chip8_recorder_push(&recorder, &chip8.screen, 
+                                        emulated_frames);
+                }
+                emulated_frames++;
+            }
         }
 
-        if (chip8.registers.sound_timer > 0)
+        if (shm_name && emulated_frames != published)
         {
-            Beep(15000, 10 * chip8.registers.sound_timer);
-            chip8.registers.sound_timer = 0;
+            chip8_shm_publish(&shm, &chip8, emulated_frames);
         }
 
-        /* Read the two bytes from memory where the program counter is pointing 
-        to. Return those two bytes as an opcode. */
-        unsigned short opcode = chip8_memory_get_short(&chip8.memory, 
-                                                       chip8.registers.PC);
-        
-        /* Increment the program counter. */
-        chip8.registers.PC += 2;
-
-        /* Execute the opcode. */
-        chip8_exec(&chip8, opcode);
+        frames++;
     }
 
 out:
+    SDL_CloseAudioDevice(audio);
+    if (trace_filename)
+    {
+        chip8_trace_close(&trace);
+    }
+    if (profile_filename)
+    {
+        FILE *file = fopen(profile_filename, "w");
+        if (!file || (chip8_profile_write(&profile, file) | fclose(file)))
+            printf("Failed to write the profile\n");
+        chip8_profile_print_summary(&profile, stdout, PROFILE_SUMMARY_SIZE);
+        chip8_profile_free(&profile);
+    }
+    if (record_filename && chip8_recorder_close(&recorder) != 0)
+    {
+        printf("Failed to write the recording\n");
+    }
+    if (chip8_script_close(&keys_script) != 0)
+    {
+        printf("Failed to write the key script\n");
+    }
+    if (netplay_arg)
+    {
+        printf("Netplay: %llu frames, %llu rollbacks, deepest %d, %llu "
+               "stalls\n", netplay.stats.frames, netplay.stats.rollbacks, 
+               netplay.stats.max_rollback_depth, netplay.stats.stalls);
+        chip8_netplay_close(&netplay);
+    }
+    chip8_shm_close(&shm);
+    chip8_phosphor_free(&phosphor);
+    if (texture)
+        SDL_DestroyTexture(texture);
     SDL_DestroyWindow(window);
     return(0);
 }